@@ -0,0 +1,333 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "netgen.h"
+#include "petrinets/petrinet.h"
+#include "petrinets/pnml.h"
+#include "petrinets/prooftree.h"
+
+namespace {
+
+/**
+ * Random marking with values in [0, max_value], the same for every run
+ */
+std::vector<int> RandomMarking(size_t place_num, int max_value, unsigned seed) {
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> values(0, max_value);
+    std::vector<int> marking(place_num);
+    for (auto&& value : marking) {
+        value = values(generator);
+    }
+    return marking;
+}
+
+/**
+ * Marking below the given one in every place, so that comparisons scan the whole row
+ */
+std::vector<int> Below(std::vector<int> marking) {
+    for (auto&& value : marking) {
+        value /= 2;
+    }
+    return marking;
+}
+
+void SetKernelLabel(benchmark::State& state) {
+    state.SetLabel(MultisetKernels::Get().name);
+}
+
+void BM_SubsetOf(benchmark::State& state) {
+    auto place_num = static_cast<size_t>(state.range(0));
+    Multiset right(RandomMarking(place_num, 8, 1));
+    Multiset left(Below(RandomMarking(place_num, 8, 1)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(left.SubsetOf(right));
+    }
+    SetKernelLabel(state);
+}
+
+void BM_Equal(benchmark::State& state) {
+    auto place_num = static_cast<size_t>(state.range(0));
+    Multiset left(RandomMarking(place_num, 8, 2));
+    Multiset right(RandomMarking(place_num, 8, 2));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(left == right);
+    }
+    SetKernelLabel(state);
+}
+
+void BM_Hash(benchmark::State& state) {
+    auto place_num = static_cast<size_t>(state.range(0));
+    Multiset set(RandomMarking(place_num, 8, 3));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(set.Hash());
+    }
+}
+
+void BM_SplitIntersection(benchmark::State& state) {
+    auto place_num = static_cast<size_t>(state.range(0));
+    Multiset left(RandomMarking(place_num, 8, 4));
+    Multiset right(RandomMarking(place_num, 8, 5));
+    Multiset left_rem(place_num), right_rem(place_num);
+    for (auto _ : state) {
+        Multiset intersect = Multiset::SplitIntersection(&left, &right, &left_rem, &right_rem);
+        benchmark::DoNotOptimize(intersect.Data());
+    }
+    SetKernelLabel(state);
+}
+
+void BM_ReduceChild(benchmark::State& state) {
+    auto place_num = static_cast<size_t>(state.range(0));
+    Multiset intersect(RandomMarking(place_num, 8, 6));
+    Multiset other_second_rem(RandomMarking(place_num, 8, 7));
+    Multiset second_rem(RandomMarking(place_num, 8, 8));
+    Multiset first_rem(RandomMarking(place_num, 8, 9));
+    for (auto _ : state) {
+        Multiset child =
+            Multiset::ReduceChild(intersect, other_second_rem, second_rem, first_rem);
+        benchmark::DoNotOptimize(child.Data());
+    }
+    SetKernelLabel(state);
+}
+
+/**
+ * The REDUCE ordering of ProofTree::SplitKey::Dominates on the split keys of a node and an
+ * ancestor below it, whose support masks pass, so that all three rows are compared
+ */
+void BM_Dominates(benchmark::State& state) {
+    auto place_num = static_cast<size_t>(state.range(0));
+    Multiset first(RandomMarking(place_num, 8, 10)), second(RandomMarking(place_num, 8, 11));
+    Multiset other_first(Below(RandomMarking(place_num, 8, 10)));
+    Multiset other_second(Below(RandomMarking(place_num, 8, 11)));
+    ProofTree::SplitKey key, other_key;
+    key.Split(first, second);
+    other_key.Split(other_first, other_second);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(key);
+        bool dominates = key.Dominates(other_key, false);
+        benchmark::DoNotOptimize(dominates);
+    }
+    SetKernelLabel(state);
+}
+
+/**
+ * Net of one transition from every place to the next, firing from a marking that enables it
+ */
+class ChainNet {
+public:
+    explicit ChainNet(size_t place_num) : net_(Transitions(place_num), place_num) {
+    }
+
+    const Transition* Get(size_t i) const {
+        return &net_.GetTransitions()[i];
+    }
+
+private:
+    static std::vector<std::tuple<std::string, std::string, std::vector<int>, std::vector<int>>>
+    Transitions(size_t place_num) {
+        std::vector<std::tuple<std::string, std::string, std::vector<int>, std::vector<int>>>
+            transitions;
+        for (size_t i = 0; i < place_num; ++i) {
+            std::vector<int> before(place_num), after(place_num);
+            before[i] = 1;
+            after[(i + 1) % place_num] = 1;
+            transitions.emplace_back("t" + std::to_string(i), "a", before, after);
+        }
+        return transitions;
+    }
+
+    PetriNet net_;
+};
+
+void BM_WeakTransition(benchmark::State& state) {
+    auto place_num = static_cast<size_t>(state.range(0));
+    ChainNet net(place_num);
+    Multiset init(RandomMarking(place_num, 8, 12));
+    for (auto _ : state) {
+        Multiset res = Multiset::WeakTransition(&init, net.Get(0));
+        benchmark::DoNotOptimize(res.Data());
+    }
+}
+
+void BM_MirrorTransition(benchmark::State& state) {
+    auto place_num = static_cast<size_t>(state.range(0));
+    ChainNet net(place_num);
+    std::vector<int> marking = RandomMarking(place_num, 8, 13);
+    marking[0] = marking[1] = 1;
+    Multiset init(marking), prev(marking), res(place_num);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            Multiset::MirrorTransition(&init, &prev, net.Get(0), net.Get(1), &res));
+    }
+}
+
+const std::vector<int64_t> kPlaceNums{8, 16, 32, 64, 256};
+
+BENCHMARK(BM_SubsetOf)->ArgsProduct({kPlaceNums});
+BENCHMARK(BM_Equal)->ArgsProduct({kPlaceNums});
+BENCHMARK(BM_Hash)->ArgsProduct({kPlaceNums});
+BENCHMARK(BM_SplitIntersection)->ArgsProduct({kPlaceNums});
+BENCHMARK(BM_ReduceChild)->ArgsProduct({kPlaceNums});
+BENCHMARK(BM_Dominates)->ArgsProduct({kPlaceNums});
+BENCHMARK(BM_WeakTransition)->ArgsProduct({kPlaceNums});
+BENCHMARK(BM_MirrorTransition)->ArgsProduct({kPlaceNums});
+
+/**
+ * Runs whole checks of a pair on a net, reporting the counters of the last one. A check stopped
+ * by the limits is still measured, its verdict is reported as unknown.
+ */
+void CheckBisimilarity(benchmark::State& state, const GeneratedNet& generated,
+                       size_t thread_num, SearchLimits limits,
+                       SearchStrategy strategy) {
+    PetriNet net(generated.net.transitions, generated.net.places.size());
+    Verdict expected = generated.bisimilar ? Verdict::kBisimilar : Verdict::kNotBisimilar;
+    Verdict verdict = Verdict::kUnknown;
+    SearchStats stats;
+    for (auto _ : state) {
+        ProofTree tree(Multiset(generated.first), Multiset(generated.second), &net, false,
+                       thread_num);
+        tree.SetLimits(limits);
+        tree.SetStrategy(strategy);
+        verdict = tree.CheckBisimilarity();
+        if (verdict != expected && verdict != Verdict::kUnknown) {
+            state.SkipWithError("Unexpected verdict");
+            return;
+        }
+        stats = tree.Stats();
+    }
+    state.counters["places"] = static_cast<double>(generated.net.places.size());
+    state.counters["transitions"] = static_cast<double>(generated.net.transitions.size());
+    state.counters["verdict"] = static_cast<double>(verdict);
+    state.counters["nodes"] = static_cast<double>(stats.nodes_created);
+    state.counters["memo_hits"] = static_cast<double>(stats.memo_hits);
+    state.counters["refuted_hits"] = static_cast<double>(stats.refuted_hits);
+    state.counters["peak_memory"] = static_cast<double>(stats.peak_memory);
+    state.counters["nodes_per_second"] =
+        benchmark::Counter(static_cast<double>(stats.nodes_created) * state.iterations(),
+                           benchmark::Counter::kIsRate);
+}
+
+/**
+ * Bundled net with a pair of resources, given by place id
+ */
+struct NetCase {
+    const char* name;
+    const char* file;
+    std::vector<std::pair<std::string, int>> first, second;
+    bool bisimilar;
+};
+
+GeneratedNet LoadCase(const NetCase& net_case) {
+    GeneratedNet result;
+    result.net = ReadPnml(std::string(BISIMILARITY_NETS_DIR) + "/" + net_case.file);
+    auto marking = [&](const std::vector<std::pair<std::string, int>>& tokens) {
+        std::vector<int> row(result.net.places.size());
+        for (auto&& [place, count] : tokens) {
+            auto it = std::find(result.net.places.begin(), result.net.places.end(), place);
+            if (it == result.net.places.end()) {
+                throw std::runtime_error(std::string(net_case.file) + " has no place " + place);
+            }
+            row[it - result.net.places.begin()] = count;
+        }
+        return row;
+    };
+    result.first = marking(net_case.first);
+    result.second = marking(net_case.second);
+    result.bisimilar = net_case.bisimilar;
+    return result;
+}
+
+void RegisterChecks() {
+    // Some bundled pairs do not finish in reasonable time, every check stops at this budget
+    SearchLimits limits;
+    limits.max_nodes = 100000;
+
+    const std::vector<NetCase> cases{
+        {"coins", "coins.pnml", {{"10c", 1}, {"shop", 1}}, {{"5c", 2}, {"shop", 1}}, true},
+        {"cyclic", "cyclic.pnml", {{"p1", 2}}, {{"p1", 1}, {"p2", 1}}, true},
+        {"test", "test.pnml", {{"p1", 3}}, {{"p2", 3}}, true},
+        {"big_cycle", "big_cycle.pnml", {{"p1", 1}}, {{"p7", 1}}, true},
+        {"exclusive", "exclusive.pnml", {{"x1", 1}}, {{"y1", 1}}, false},
+    };
+    for (auto&& net_case : cases) {
+        benchmark::RegisterBenchmark(("BM_CheckNet/" + std::string(net_case.name)).c_str(),
+                                     CheckBisimilarity, LoadCase(net_case), 1, limits,
+                                     SearchStrategy())
+            ->Unit(benchmark::kMicrosecond);
+    }
+
+    auto add = [&](const std::string& name, const GeneratedNet& generated) {
+        for (size_t thread_num : {1, 4}) {
+            benchmark::RegisterBenchmark(
+                (name + "/threads:" + std::to_string(thread_num)).c_str(), CheckBisimilarity,
+                generated, thread_num, limits, SearchStrategy())
+                ->Unit(benchmark::kMicrosecond)
+                ->UseRealTime();
+        }
+    };
+    for (size_t places : {8, 32, 128}) {
+        for (size_t labels : {1, 2, 4}) {
+            add("BM_CheckCycle/places:" + std::to_string(places) + "/labels:" +
+                    std::to_string(labels),
+                CycleNet(places, labels, 2));
+        }
+    }
+    for (size_t branches : {2, 4, 8}) {
+        for (size_t depth : {1, 4}) {
+            for (bool bisimilar : {true, false}) {
+                add("BM_CheckChoice/branches:" + std::to_string(branches) + "/depth:" +
+                        std::to_string(depth) + "/bisimilar:" + std::to_string(bisimilar),
+                    ChoiceNet(branches, depth, bisimilar));
+            }
+        }
+    }
+    for (size_t denominations : {2, 3, 4}) {
+        for (int purchases : {1, 2}) {
+            add("BM_CheckCoins/denominations:" + std::to_string(denominations) +
+                    "/purchases:" + std::to_string(purchases),
+                CoinNet(denominations, purchases));
+        }
+    }
+
+    // The same checks in the other orders of the search
+    const std::vector<std::pair<std::string, SearchStrategy>> strategies{
+        {"deepening", {4, ChildOrder::kNet, GammaOrder::kNet}},
+        {"farthest", {0, ChildOrder::kFarthestFirst, GammaOrder::kNet}},
+        {"closest", {0, ChildOrder::kNet, GammaOrder::kClosestFirst}},
+        {"farthest_closest", {0, ChildOrder::kFarthestFirst, GammaOrder::kClosestFirst}},
+    };
+    const std::vector<std::pair<std::string, GeneratedNet>> strategy_nets{
+        {"choice:bisimilar", ChoiceNet(8, 4, true)},
+        {"choice:refuted", ChoiceNet(8, 4, false)},
+        {"coins", CoinNet(4, 1)},
+    };
+    for (auto&& [strategy_name, strategy] : strategies) {
+        for (auto&& [net_name, generated] : strategy_nets) {
+            for (size_t thread_num : {1, 4}) {
+                benchmark::RegisterBenchmark(("BM_CheckStrategy/" + strategy_name + "/" +
+                                              net_name + "/threads:" +
+                                              std::to_string(thread_num))
+                                                 .c_str(),
+                                             CheckBisimilarity, generated, thread_num, limits,
+                                             strategy)
+                    ->Unit(benchmark::kMicrosecond)
+                    ->UseRealTime();
+            }
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    RegisterChecks();
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
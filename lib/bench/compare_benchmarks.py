@@ -0,0 +1,52 @@
+"""Compares two JSON outputs of the benchmarks target and reports the regressions.
+
+Usage: python compare_benchmarks.py BASELINE.json CONTENDER.json [--threshold PERCENT]
+
+Exits with 1 if a benchmark got slower by more than the threshold or a check created more
+nodes, which means the search itself changed.
+"""
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as file:
+        data = json.load(file)
+    return {b['name']: b for b in data['benchmarks'] if b.get('run_type', 'iteration') == 'iteration'}
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compares two benchmark runs')
+    parser.add_argument('baseline')
+    parser.add_argument('contender')
+    parser.add_argument('--threshold', type=float, default=10.0,
+                        help='allowed slowdown in percent, 10 by default')
+    args = parser.parse_args()
+
+    baseline, contender = load(args.baseline), load(args.contender)
+    regressions = 0
+    print(f'{"Benchmark":<70} {"Baseline":>12} {"Contender":>12} {"Change":>8}')
+    for name, old in baseline.items():
+        new = contender.get(name)
+        if new is None or 'error_message' in old or 'error_message' in new:
+            continue
+        change = (new['real_time'] - old['real_time']) / old['real_time'] * 100
+        notes = []
+        if change > args.threshold:
+            notes.append('slower')
+        if 'nodes' in old and new.get('nodes', 0) > old['nodes']:
+            notes.append(f'nodes {old["nodes"]:.0f} -> {new["nodes"]:.0f}')
+        regressions += bool(notes)
+        unit = old['time_unit']
+        print(f'{name:<70} {old["real_time"]:>10.2f}{unit:>2} {new["real_time"]:>10.2f}{unit:>2} '
+              f'{change:>+7.1f}% {", ".join(notes)}')
+    missing = set(baseline) - set(contender)
+    if missing:
+        print(f'{len(missing)} benchmarks of the baseline are missing')
+    print(f'{regressions} regressions')
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,120 @@
+#include "netgen.h"
+#include <functional>
+#include <string>
+
+namespace {
+
+/**
+ * Adds a transition moving tokens between places, with unit arcs
+ */
+void AddTransition(PnmlNet* net, const std::string& label, const std::vector<size_t>& before,
+                   const std::vector<size_t>& after) {
+    std::vector<int> before_row(net->places.size()), after_row(net->places.size());
+    for (size_t place : before) {
+        ++before_row[place];
+    }
+    for (size_t place : after) {
+        ++after_row[place];
+    }
+    std::string id = "t" + std::to_string(net->transitions.size() + 1);
+    net->transitions.emplace_back(id, label, std::move(before_row), std::move(after_row));
+}
+
+size_t AddPlace(PnmlNet* net, const std::string& id) {
+    net->places.push_back(id);
+    return net->places.size() - 1;
+}
+
+}  // namespace
+
+GeneratedNet CycleNet(size_t places, size_t labels, int tokens) {
+    GeneratedNet result;
+    for (size_t i = 0; i < places; ++i) {
+        AddPlace(&result.net, "p" + std::to_string(i + 1));
+    }
+    for (size_t i = 0; i < places; ++i) {
+        AddTransition(&result.net, "l" + std::to_string(i % labels), {i}, {(i + 1) % places});
+    }
+    result.first.assign(places, 0);
+    result.second.assign(places, 0);
+    result.first[0] += tokens;
+    result.second[labels % places] += tokens;
+    result.bisimilar = places % labels == 0;
+    return result;
+}
+
+GeneratedNet ChoiceNet(size_t branches, size_t depth, bool bisimilar) {
+    GeneratedNet result;
+    PnmlNet* net = &result.net;
+    // Places are created before the transitions, whose rows have one value per place
+    std::vector<size_t> starts;
+    std::vector<std::vector<std::vector<size_t>>> chains(2);
+    for (size_t copy = 0; copy < 2; ++copy) {
+        std::string prefix = copy == 0 ? "x" : "y";
+        starts.push_back(AddPlace(net, prefix));
+        for (size_t branch = 0; branch < branches; ++branch) {
+            chains[copy].emplace_back();
+            for (size_t step = 0; step <= depth; ++step) {
+                chains[copy].back().push_back(AddPlace(
+                    net, prefix + std::to_string(branch + 1) + "_" + std::to_string(step)));
+            }
+        }
+    }
+    for (size_t copy = 0; copy < 2; ++copy) {
+        for (size_t branch = 0; branch < branches; ++branch) {
+            const auto& chain = chains[copy][branch];
+            AddTransition(net, "a", {starts[copy]}, {chain[0]});
+            for (size_t step = 0; step < depth; ++step) {
+                std::string label = "l" + std::to_string(branch) + "_" + std::to_string(step);
+                if (!bisimilar && copy == 1 && branch + 1 == branches && step + 1 == depth) {
+                    label = "other";
+                }
+                AddTransition(net, label, {chain[step]}, {chain[step + 1]});
+            }
+        }
+    }
+    result.first.assign(net->places.size(), 0);
+    result.second.assign(net->places.size(), 0);
+    result.first[starts[0]] = 1;
+    result.second[starts[1]] = 1;
+    result.bisimilar = bisimilar || branches == 0 || depth == 0;
+    return result;
+}
+
+GeneratedNet CoinNet(size_t denominations, int purchases) {
+    GeneratedNet result;
+    PnmlNet* net = &result.net;
+    std::vector<size_t> coins;
+    for (size_t i = 0; i < denominations; ++i) {
+        coins.push_back(AddPlace(net, std::to_string(1 << i) + "c"));
+    }
+    size_t shop = AddPlace(net, "shop");
+    size_t bought = AddPlace(net, "bought");
+
+    // Every multiset of coins worth the price, from the largest coins down
+    int price = 1 << denominations;
+    std::vector<size_t> payment{shop};
+    std::function<void(size_t, int)> pay = [&](size_t coin, int rest) {
+        if (coin == 0) {
+            payment.insert(payment.end(), rest, coins[0]);
+            AddTransition(net, "b", payment, {bought});
+            payment.resize(payment.size() - rest);
+            return;
+        }
+        int value = 1 << coin;
+        for (int count = 0; count * value <= rest; ++count) {
+            pay(coin - 1, rest - count * value);
+            payment.push_back(coins[coin]);
+        }
+        payment.resize(payment.size() - (rest / value + 1));
+    };
+    pay(denominations - 1, price);
+
+    result.first.assign(net->places.size(), 0);
+    result.second.assign(net->places.size(), 0);
+    result.first[coins.back()] = purchases * (price >> (denominations - 1));
+    result.second[coins[0]] = purchases * price;
+    result.first[shop] = purchases;
+    result.second[shop] = purchases;
+    return result;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include "petrinets/pnml.h"
+
+/**
+ * Synthetic net with a pair of resources whose verdict is known in advance
+ */
+struct GeneratedNet {
+    PnmlNet net;
+    std::vector<int> first, second;
+    bool bisimilar = true;
+};
+
+/**
+ * Generates a cycle of places, each passing its tokens to the next one, like nets/big_cycle.pnml.
+ * Transition i is labelled with i modulo the number of labels, so places a multiple of the label
+ * count apart are bisimilar.
+ * @param places number of places and transitions
+ * @param labels number of distinct labels, a divisor of the places
+ * @param tokens tokens of both resources
+ * @return net with the tokens on the first place against the same tokens on place labels
+ */
+GeneratedNet CycleNet(size_t places, size_t labels, int tokens);
+
+/**
+ * Generates two copies of an exclusive choice, like nets/exclusive.pnml. Each copy starts at a
+ * place with a transition labelled a into every branch, and every branch is a chain of steps
+ * with labels of its own.
+ * @param branches number of branches of each copy
+ * @param depth transitions on every branch after the choice
+ * @param bisimilar keep the copies equal, otherwise the last step of the last branch of the
+ * second copy gets a new label
+ * @return net with a token on the start of the first copy against one on the second
+ */
+GeneratedNet ChoiceNet(size_t branches, size_t depth, bool bisimilar);
+
+/**
+ * Generates a shop selling for coins, like nets/coins.pnml. Coin i is worth 2^i and every way
+ * of paying the price 2^denominations is a transition labelled b from a shop token to a bought
+ * item, so the transitions grow quickly with the denominations.
+ * @param denominations number of coin values, at least 1
+ * @param purchases shop tokens of both resources
+ * @return net with the price of every purchase paid in the largest coins against the smallest
+ */
+GeneratedNet CoinNet(size_t denominations, int purchases);
@@ -1,27 +1,745 @@
+#include <pybind11/functional.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include "petrinets/certificate.h"
 #include "petrinets/petrinet.h"
 #include "petrinets/prooftree.h"
+#include "petrinets/treefile.h"
 
 namespace py = pybind11;
 
-bool CheckBisimilarity(
-    std::vector<int> resource_one, std::vector<int> resource_two,
-    std::vector<std::tuple<std::string, std::string, std::vector<int>, std::vector<int>>>
-        transitions,
-    bool record_basis, std::string path) {
-    Multiset first(std::move(resource_one)), second(std::move(resource_two));
-    PetriNet net(transitions);
-    ProofTree tree(first, second, &net, record_basis);
-    bool res = tree.CheckBisimilarity();
-    tree.PrintTree(std::ofstream{path});
-    return res;
+using TransitionList =
+    std::vector<std::tuple<std::string, std::string, std::vector<int>, std::vector<int>>>;
+
+bool EndsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() &&
+           text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/**
+ * Read-only view of one of the arrays of a result, exported through the buffer protocol. It
+ * shares the ownership of the arrays, so the views outlive the result they came from.
+ */
+struct ArrayView {
+    std::shared_ptr<const TreeArrays> owner;
+    const void* data;
+    py::ssize_t itemsize;
+    std::string format;
+    std::vector<py::ssize_t> shape;
+};
+
+template <class T>
+ArrayView MakeView(std::shared_ptr<const TreeArrays> owner, const std::vector<T>& data,
+                   std::vector<py::ssize_t> shape) {
+    return {std::move(owner), data.data(), sizeof(T), py::format_descriptor<T>::format(),
+            std::move(shape)};
+}
+
+/**
+ * View of an array with a value per node
+ */
+template <class T>
+ArrayView NodeColumn(std::shared_ptr<const TreeArrays> arrays, const std::vector<T>& data) {
+    auto count = static_cast<py::ssize_t>(arrays->node_count);
+    return MakeView(std::move(arrays), data, {count});
 }
 
+/**
+ * Finished check owning its net and proof tree, so the tree can be inspected or written later
+ */
+class CheckResult {
+public:
+    CheckResult(std::shared_ptr<PetriNet> net, std::vector<int> resource_one,
+                std::vector<int> resource_two, bool record_basis, size_t threads)
+        : net_(std::move(net)),
+          tree_(Multiset(std::move(resource_one)), Multiset(std::move(resource_two)), net_.get(),
+                record_basis, threads) {
+    }
+
+    ProofTree& Tree() {
+        return tree_;
+    }
+
+    [[nodiscard]] const ProofTree& Tree() const {
+        return tree_;
+    }
+
+    void Finish(Verdict verdict) {
+        verdict_ = verdict;
+        stats_ = tree_.Stats();
+    }
+
+    [[nodiscard]] std::optional<bool> GetVerdict() const {
+        if (verdict_ == Verdict::kUnknown) {
+            return std::nullopt;
+        }
+        return verdict_ == Verdict::kBisimilar;
+    }
+
+    [[nodiscard]] const SearchStats& Stats() const {
+        return stats_;
+    }
+
+    /**
+     * Writes the tree as GraphML, or in the binary format if the path ends with .ptree
+     */
+    void Write(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (EndsWith(path, ".ptree")) {
+            tree_.WriteBinary(path);
+        } else {
+            tree_.PrintTree(path);
+        }
+    }
+
+    void WriteTrace(const std::string& path) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tree_.WriteTrace(path);
+    }
+
+    void WriteCertificate(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tree_.WriteCertificate(path);
+    }
+
+    /**
+     * Starts a check from the tree of this result, see ProofTree::Reuse
+     */
+    void ReuseIn(ProofTree* tree) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tree->Reuse(tree_);
+    }
+
+    /**
+     * Flattens the tree on the first call, the arrays are shared by every view
+     */
+    std::shared_ptr<const TreeArrays> Arrays() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (arrays_ == nullptr) {
+            arrays_ = std::make_shared<const TreeArrays>(tree_.ToArrays());
+        }
+        return arrays_;
+    }
+
+private:
+    std::shared_ptr<PetriNet> net_;  // shared with the handle and the other results of the net
+    ProofTree tree_;
+    // The writers number the nodes of the tree and run without the GIL, so they take turns
+    mutable std::mutex mutex_;
+    Verdict verdict_ = Verdict::kUnknown;
+    SearchStats stats_;
+    std::shared_ptr<const TreeArrays> arrays_;
+};
+
+void FillStats(const SearchStats& search_stats, py::dict stats) {
+    stats["nodes_created"] = search_stats.nodes_created;
+    stats["memo_hits"] = search_stats.memo_hits;
+    stats["memo_misses"] = search_stats.memo_misses;
+    stats["refuted_hits"] = search_stats.refuted_hits;
+    stats["peak_memory"] = search_stats.peak_memory;
+    stats["seconds"] = search_stats.seconds;
+    stats["reused_pairs"] = search_stats.reused_pairs;
+    stats["hinted_nodes"] = search_stats.hinted_nodes;
+    stats["spilled_nodes"] = search_stats.spilled_nodes;
+    stats["deepening_passes"] = search_stats.deepening_passes;
+    if (!search_stats.profiled) {
+        return;
+    }
+    const SearchProfile& profile = search_stats.profile;
+    stats["expand_iterations"] = profile.expand_iterations;
+    stats["backtracks"] = profile.backtracks;
+    stats["max_backtracks"] = profile.max_backtracks;
+    stats["candidates_tried"] = profile.candidates_tried;
+    stats["candidates_rejected"] = profile.candidates_rejected;
+    stats["reduce_comparisons"] = profile.reduce_comparisons;
+    stats["reduce_hits"] = profile.reduce_hits;
+    stats["max_depth"] = profile.max_depth;
+    py::dict phases;
+    for (size_t i = 0; i < profile.phase_seconds.size(); ++i) {
+        phases[PhaseName(static_cast<SearchPhase>(i))] = profile.phase_seconds[i];
+    }
+    stats["phase_seconds"] = phases;
+    stats["transition_tried"] = profile.transition_tried;
+    stats["transition_rejected"] = profile.transition_rejected;
+}
+
+/**
+ * Runs a check with the GIL released
+ * @param shared pairs proven by other checks of the net, nullptr if not shared
+ * @param certifiable keep what CheckResult::WriteCertificate needs, see ProofTree::SetCertifiable
+ * @param profile profile the check, recording the subtrees above trace_depth for the trace
+ * @param previous earlier check of a slightly different net or pair to start from, or nullptr
+ * @param spill scratch file for the proven subtrees evicted during the search, empty to keep
+ * the whole tree in memory
+ * @param callback_error set to the exception raised by the progress callback, which stops the
+ * search
+ */
+std::unique_ptr<CheckResult> RunCheck(std::shared_ptr<PetriNet> net, SharedMemo* shared,
+                                      std::vector<int> resource_one,
+                                      std::vector<int> resource_two, bool record_basis,
+                                      size_t threads, const SearchLimits& limits,
+                                      const SearchStrategy& strategy,
+                                      const CancellationToken* cancel,
+                                      std::function<void(size_t, int, double)> progress,
+                                      double progress_interval, bool memoize, bool certifiable,
+                                      bool profile, int trace_depth, const CheckResult* previous,
+                                      const std::string& spill,
+                                      std::exception_ptr* callback_error) {
+    CancellationToken stop(cancel);
+    std::unique_ptr<CheckResult> result;
+    {
+        py::gil_scoped_release release;
+        result = std::make_unique<CheckResult>(std::move(net), std::move(resource_one),
+                                               std::move(resource_two), record_basis, threads);
+        ProofTree& tree = result->Tree();
+        tree.SetStrategy(strategy);
+        tree.SetCertifiable(certifiable);
+        if (previous != nullptr) {
+            previous->ReuseIn(&tree);
+        }
+        tree.SetLimits(limits);
+        tree.SetCancellation(&stop);
+        tree.SetMemoization(memoize);
+        tree.SetSharedMemo(shared);
+        tree.SetProfiling(profile, trace_depth);
+        tree.SetSpilling(spill);
+        if (progress) {
+            tree.SetProgressCallback(
+                [&](const SearchProgress& state) {
+                    if (*callback_error) {
+                        return;
+                    }
+                    try {
+                        progress(state.nodes, state.depth, state.nodes_per_second);
+                    } catch (...) {
+                        *callback_error = std::current_exception();
+                        stop.Cancel();
+                    }
+                },
+                progress_interval);
+        }
+        result->Finish(tree.CheckBisimilarity());
+        // The token only lives for this call
+        tree.SetCancellation(nullptr);
+        tree.SetProgressCallback(nullptr, progress_interval);
+        tree.SetSharedMemo(nullptr);
+    }
+    return result;
+}
+
+/**
+ * Compiles a net given by the rows of its transitions
+ * @param place_num number of places, the length of the rows if not given
+ */
+std::shared_ptr<PetriNet> MakeNet(const TransitionList& transitions,
+                                  std::optional<size_t> place_num) {
+    if (!place_num) {
+        if (transitions.empty()) {
+            throw std::invalid_argument("A net without transitions needs its number of places");
+        }
+        place_num = std::get<2>(transitions.front()).size();
+    }
+    return std::make_shared<PetriNet>(transitions, *place_num);
+}
+
+std::unique_ptr<CheckResult> Check(std::vector<int> resource_one, std::vector<int> resource_two,
+                                   const TransitionList& transitions, bool record_basis,
+                                   size_t threads, int max_depth, size_t max_nodes,
+                                   size_t max_memory, double max_seconds,
+                                   const CancellationToken* cancel,
+                                   std::function<void(size_t, int, double)> progress,
+                                   double progress_interval, bool memoize, bool profile,
+                                   int trace_depth, const CheckResult* previous,
+                                   const SearchStrategy& strategy, bool certificate) {
+    std::exception_ptr callback_error;
+    auto net = MakeNet(transitions, resource_one.size());
+    auto result = RunCheck(std::move(net), nullptr, std::move(resource_one),
+                           std::move(resource_two), record_basis, threads,
+                           {max_depth, max_nodes, max_memory, max_seconds}, strategy,
+                           cancel, std::move(progress), progress_interval, memoize, certificate,
+                           profile, trace_depth, previous, "", &callback_error);
+    if (callback_error) {
+        std::rethrow_exception(callback_error);
+    }
+    return result;
+}
+
+std::optional<bool> CheckBisimilarity(
+    std::vector<int> resource_one, std::vector<int> resource_two, const TransitionList& transitions,
+    bool record_basis, std::string path, size_t threads, int max_depth, size_t max_nodes,
+    size_t max_memory, double max_seconds, const CancellationToken* cancel,
+    std::function<void(size_t, int, double)> progress, double progress_interval, bool memoize,
+    std::optional<py::dict> stats, bool profile, const std::string& spill,
+    const SearchStrategy& strategy) {
+    // The callback may raise, which stops the search and is rethrown once the tree is written
+    std::exception_ptr callback_error;
+    auto net = MakeNet(transitions, resource_one.size());
+    auto result = RunCheck(std::move(net), nullptr, std::move(resource_one),
+                           std::move(resource_two), record_basis, threads,
+                           {max_depth, max_nodes, max_memory, max_seconds}, strategy,
+                           cancel, std::move(progress), progress_interval, memoize, false,
+                           profile, 0, nullptr, spill, &callback_error);
+    {
+        py::gil_scoped_release release;
+        result->Write(path);
+    }
+    if (stats) {
+        FillStats(result->Stats(), *stats);
+    }
+    if (callback_error) {
+        std::rethrow_exception(callback_error);
+    }
+    return result->GetVerdict();
+}
+
+/**
+ * Petri net compiled once and checked against many pairs of resources. Pairs proven bisimilar
+ * by any of its checks close the same pairs in the later ones.
+ */
+class NetHandle {
+public:
+    NetHandle(const TransitionList& transitions, std::optional<size_t> place_num)
+        : net_(MakeNet(transitions, place_num)),
+          shared_(std::make_unique<SharedMemo>(net_->GetPlaceNum())) {
+    }
+
+    std::unique_ptr<CheckResult> Check(std::vector<int> resource_one,
+                                       std::vector<int> resource_two, bool record_basis,
+                                       size_t threads, int max_depth, size_t max_nodes,
+                                       size_t max_memory, double max_seconds,
+                                       const CancellationToken* cancel,
+                                       std::function<void(size_t, int, double)> progress,
+                                       double progress_interval, bool memoize, bool profile,
+                                       int trace_depth, const CheckResult* previous,
+                                       const SearchStrategy& strategy, bool certificate) {
+        std::exception_ptr callback_error;
+        auto result = RunCheck(net_, shared_.get(), std::move(resource_one),
+                               std::move(resource_two), record_basis, threads,
+                               {max_depth, max_nodes, max_memory, max_seconds}, strategy, cancel,
+                               std::move(progress), progress_interval, memoize, certificate,
+                               profile, trace_depth, previous, "", &callback_error);
+        if (callback_error) {
+            std::rethrow_exception(callback_error);
+        }
+        return result;
+    }
+
+    /**
+     * Checks the pairs in parallel, one sequential tree per pair
+     * @param trees return the results with their trees instead of the verdicts only
+     * @return verdicts or results in the order of the pairs
+     */
+    py::list CheckMany(const std::vector<std::pair<std::vector<int>, std::vector<int>>>& pairs,
+                       size_t threads, bool trees, bool record_basis, int max_depth,
+                       size_t max_nodes, size_t max_memory, double max_seconds,
+                       const CancellationToken* cancel, bool memoize,
+                       const SearchStrategy& strategy) {
+        std::vector<Verdict> verdicts(pairs.size(), Verdict::kUnknown);
+        std::vector<std::unique_ptr<CheckResult>> results(trees ? pairs.size() : 0);
+        std::exception_ptr error;
+        {
+            py::gil_scoped_release release;
+            CancellationToken stop(cancel);
+            std::mutex error_mutex;
+            std::atomic<size_t> next{0};
+            SearchLimits limits{max_depth, max_nodes, max_memory, max_seconds};
+            // Pairs are handed out one at a time, so long checks do not hold up the others
+            auto work = [&] {
+                for (size_t i = next++; i < pairs.size() && !stop.IsCancelled(); i = next++) {
+                    try {
+                        auto result = std::make_unique<CheckResult>(
+                            net_, pairs[i].first, pairs[i].second, record_basis && trees, 1);
+                        ProofTree& tree = result->Tree();
+                        tree.SetLimits(limits);
+                        tree.SetStrategy(strategy);
+                        tree.SetCancellation(&stop);
+                        tree.SetMemoization(memoize);
+                        tree.SetSharedMemo(shared_.get());
+                        verdicts[i] = tree.CheckBisimilarity();
+                        result->Finish(verdicts[i]);
+                        tree.SetCancellation(nullptr);
+                        tree.SetSharedMemo(nullptr);
+                        if (trees) {
+                            results[i] = std::move(result);
+                        }
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(error_mutex);
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                        stop.Cancel();
+                    }
+                }
+            };
+            size_t worker_num = std::min(threads, pairs.size());
+            if (worker_num > 1) {
+                ThreadPool pool(worker_num - 1);
+                TaskGroup group(&pool);
+                for (size_t i = 1; i < worker_num; ++i) {
+                    group.Run(work);
+                }
+                work();
+                group.Wait();
+            } else {
+                work();
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        py::list output;
+        for (size_t i = 0; i < pairs.size(); ++i) {
+            if (trees) {
+                output.append(py::cast(std::move(results[i])));
+            } else if (verdicts[i] == Verdict::kUnknown) {
+                output.append(py::none());
+            } else {
+                output.append(verdicts[i] == Verdict::kBisimilar);
+            }
+        }
+        return output;
+    }
+
+    [[nodiscard]] size_t PlaceNum() const {
+        return net_->GetPlaceNum();
+    }
+
+    [[nodiscard]] size_t TransitionNum() const {
+        return net_->GetTransitions().size();
+    }
+
+    [[nodiscard]] size_t KnownPairs() const {
+        return shared_->Size();
+    }
+
+    [[nodiscard]] CertificateReport Verify(const std::string& path, size_t threads) const {
+        return VerifyCertificate(path, *net_, threads);
+    }
+
+private:
+    std::shared_ptr<PetriNet> net_;
+    std::unique_ptr<SharedMemo> shared_;
+};
+
 PYBIND11_MODULE(_core, module) {
     module.doc() = "Binding for the main bisimilarity checking function";
+    py::class_<CancellationToken>(module, "CancellationToken",
+                                  "Flag stopping a running check from another Python thread")
+        .def(py::init<>())
+        .def("cancel", &CancellationToken::Cancel)
+        .def_property_readonly("cancelled", &CancellationToken::IsCancelled);
+    py::enum_<ChildOrder>(module, "ChildOrder",
+                          "Order in which the children of a node are searched")
+        .value("NET", ChildOrder::kNet, "By transition, in the order of the net")
+        .value("FARTHEST_FIRST", ChildOrder::kFarthestFirst,
+               "Pairs with the most tokens outside of their intersection first, as the likeliest "
+               "to fail");
+    py::enum_<GammaOrder>(module, "GammaOrder",
+                          "Order in which the transitions mirroring a transition are tried")
+        .value("NET", GammaOrder::kNet, "In the order of the net")
+        .value("CLOSEST_FIRST", GammaOrder::kClosestFirst,
+               "Transitions with the before and after rows closest to those of the mirrored one "
+               "first");
+    py::class_<SearchStrategy>(module, "SearchStrategy",
+                               "Order in which a check explores the tree. The verdict does not "
+                               "depend on it, only the time taken and the proof found.")
+        .def(py::init([](int deepening_step, ChildOrder child_order, GammaOrder gamma_order) {
+                 return SearchStrategy{deepening_step, child_order, gamma_order};
+             }),
+             py::arg("deepening_step") = 0, py::arg("child_order") = ChildOrder::kNet,
+             py::arg("gamma_order") = GammaOrder::kNet)
+        .def_readwrite("deepening_step", &SearchStrategy::deepening_step,
+                       "Iterative deepening bounds the EXPAND steps on a branch by this many in "
+                       "the first pass and by as many more in every next one, 0 to search "
+                       "depth-first without a bound")
+        .def_readwrite("child_order", &SearchStrategy::child_order)
+        .def_readwrite("gamma_order", &SearchStrategy::gamma_order);
+    py::class_<TreeFile::Node>(module, "TreeNode", "Node of a binary proof tree")
+        .def_readonly("id", &TreeFile::Node::id)
+        .def_property_readonly("parent",
+                               [](const TreeFile::Node& node) -> std::optional<uint64_t> {
+                                   if (node.parent == treefile::kNone) {
+                                       return std::nullopt;
+                                   }
+                                   return node.parent;
+                               })
+        .def_property_readonly("reduced",
+                               [](const TreeFile::Node& node) -> std::optional<uint64_t> {
+                                   if (node.reduced == treefile::kNone) {
+                                       return std::nullopt;
+                                   }
+                                   return node.reduced;
+                               })
+        .def_property_readonly("children",
+                               [](const TreeFile::Node& node) {
+                                   return py::make_tuple(node.first_child,
+                                                         node.first_child + node.child_count);
+                               })
+        .def_readonly("child_count", &TreeFile::Node::child_count)
+        .def_readonly("delta", &TreeFile::Node::delta)
+        .def_readonly("gamma", &TreeFile::Node::gamma)
+        .def_readonly("order", &TreeFile::Node::order)
+        .def_readonly("memo", &TreeFile::Node::memo)
+        .def_readonly("terminal", &TreeFile::Node::terminal)
+        .def_readonly("first", &TreeFile::Node::first)
+        .def_readonly("second", &TreeFile::Node::second);
+    py::class_<TreeFile>(module, "TreeFile",
+                         "Proof tree written to a .ptree file, mapped into memory and decoded one "
+                         "node at a time")
+        .def(py::init<const std::string&>(), py::arg("path"))
+        .def_property_readonly("node_count", &TreeFile::NodeCount)
+        .def_property_readonly("place_num", &TreeFile::PlaceNum)
+        .def_property_readonly("verdict",
+                               [](const TreeFile& file) -> std::optional<bool> {
+                                   if (file.Verdict() == treefile::kUnknown) {
+                                       return std::nullopt;
+                                   }
+                                   return file.Verdict() == treefile::kBisimilar;
+                               })
+        .def_property_readonly(
+            "transitions",
+            [](const TreeFile& file) {
+                std::vector<std::tuple<std::string, std::string, std::vector<int>>> result;
+                for (auto&& transition : file.Transitions()) {
+                    result.emplace_back(transition.id, transition.label, transition.change);
+                }
+                return result;
+            },
+            "Transitions as (id, label, change) by index, as referred to by delta and gamma")
+        .def("node", &TreeFile::GetNode, py::arg("id"))
+        .def("basis", &TreeFile::Basis)
+        .def("write_graphml", &TreeFile::WriteGraphML, py::arg("path"),
+             "Converts the tree to the GraphML format of check_bisimilarity",
+             py::call_guard<py::gil_scoped_release>());
+    py::class_<ArrayView>(module, "ArrayView", py::buffer_protocol(),
+                          "Read-only array of a CheckResult, wrap it with numpy.asarray or "
+                          "memoryview to read it without copying")
+        .def_buffer([](ArrayView& view) {
+            std::vector<py::ssize_t> strides(view.shape.size());
+            py::ssize_t stride = view.itemsize;
+            for (size_t i = view.shape.size(); i-- > 0;) {
+                strides[i] = stride;
+                stride *= view.shape[i];
+            }
+            return py::buffer_info(const_cast<void*>(view.data), view.itemsize, view.format,
+                                   static_cast<py::ssize_t>(view.shape.size()), view.shape,
+                                   strides, true);
+        })
+        .def("__len__", [](const ArrayView& view) { return view.shape[0]; });
+
+    py::class_<CheckResult>(module, "CheckResult",
+                            "Finished check owning its proof tree. The node arrays are indexed "
+                            "by node id, the markings have a row per node.")
+        .def_property_readonly("verdict", &CheckResult::GetVerdict,
+                               "True if the resources are bisimilar, False if they are not, None "
+                               "if the search was stopped")
+        .def_property_readonly("stats",
+                               [](const CheckResult& result) {
+                                   py::dict stats;
+                                   FillStats(result.Stats(), stats);
+                                   return stats;
+                               })
+        .def_property_readonly("node_count",
+                               [](CheckResult& result) { return result.Arrays()->node_count; })
+        .def_property_readonly("first",
+                               [](CheckResult& result) {
+                                   auto arrays = result.Arrays();
+                                   auto width = static_cast<py::ssize_t>(arrays->place_num);
+                                   return MakeView(arrays, arrays->first,
+                                                   {static_cast<py::ssize_t>(arrays->node_count),
+                                                    width});
+                               })
+        .def_property_readonly("second",
+                               [](CheckResult& result) {
+                                   auto arrays = result.Arrays();
+                                   auto width = static_cast<py::ssize_t>(arrays->place_num);
+                                   return MakeView(arrays, arrays->second,
+                                                   {static_cast<py::ssize_t>(arrays->node_count),
+                                                    width});
+                               })
+        .def_property_readonly("parent",
+                               [](CheckResult& result) {
+                                   auto arrays = result.Arrays();
+                                   return NodeColumn(arrays, arrays->parent);
+                               },
+                               "Parent of every node, -1 for the root")
+        .def_property_readonly("edges",
+                               [](CheckResult& result) {
+                                   auto arrays = result.Arrays();
+                                   auto count = static_cast<py::ssize_t>(arrays->edges.size() / 2);
+                                   return MakeView(arrays, arrays->edges, {count, 2});
+                               },
+                               "(parent, child) pairs")
+        .def_property_readonly("delta",
+                               [](CheckResult& result) {
+                                   auto arrays = result.Arrays();
+                                   return NodeColumn(arrays, arrays->delta);
+                               },
+                               "Index of the delta transition, -1 if the node is not a delta "
+                               "child")
+        .def_property_readonly("gamma",
+                               [](CheckResult& result) {
+                                   auto arrays = result.Arrays();
+                                   return NodeColumn(arrays, arrays->gamma);
+                               })
+        .def_property_readonly("order",
+                               [](CheckResult& result) {
+                                   auto arrays = result.Arrays();
+                                   return NodeColumn(arrays, arrays->order);
+                               },
+                               "1 for the direct order, -1 for the reverse, 0 if not expanded")
+        .def_property_readonly("reduced",
+                               [](CheckResult& result) {
+                                   auto arrays = result.Arrays();
+                                   return NodeColumn(arrays, arrays->reduced);
+                               },
+                               "Ancestor used by REDUCE, -1 if none")
+        .def_property_readonly("memo",
+                               [](CheckResult& result) {
+                                   auto arrays = result.Arrays();
+                                   return NodeColumn(arrays, arrays->memo);
+                               },
+                               "1 if closed as proven by the transposition table, -1 if as "
+                               "refuted, 0 otherwise")
+        .def_property_readonly("terminal",
+                               [](CheckResult& result) {
+                                   auto arrays = result.Arrays();
+                                   return NodeColumn(arrays, arrays->terminal);
+                               },
+                               "0 for inner nodes, 1 for successful leaves, 2 for failed ones")
+        .def_property_readonly(
+            "basis",
+            [](CheckResult& result) {
+                auto arrays = result.Arrays();
+                std::vector<py::ssize_t> shape{static_cast<py::ssize_t>(arrays->basis_count),
+                                               static_cast<py::ssize_t>(arrays->place_num)};
+                return py::make_tuple(MakeView(arrays, arrays->basis_first, shape),
+                                      MakeView(arrays, arrays->basis_second, shape));
+            },
+            "Pair of arrays with the first and second markings of the basis pairs, empty unless "
+            "the basis was recorded and the resources are bisimilar")
+        .def_property_readonly("transitions", [](CheckResult& result) {
+            return result.Tree().TransitionStrings();
+        })
+        .def("write", &CheckResult::Write, py::arg("path"),
+             "Writes the tree as GraphML, compressed with gzip or zstd if the path ends with .gz "
+             "or .zst, or in the binary format read by TreeFile if it ends with .ptree",
+             py::call_guard<py::gil_scoped_release>())
+        .def("write_trace", &CheckResult::WriteTrace, py::arg("path"),
+             "Writes the subtrees recorded by a profiled check as a Chrome trace, viewable in "
+             "chrome://tracing or Perfetto, with the profile counters in its metadata",
+             py::call_guard<py::gil_scoped_release>())
+        .def("write_certificate", &CheckResult::WriteCertificate, py::arg("path"),
+             "Writes a proof certificate checked by verify_certificate without searching, with "
+             "the basis if it was recorded. Raises unless the resources were proven bisimilar "
+             "by a check with certificate or without memoize.",
+             py::call_guard<py::gil_scoped_release>());
+    py::class_<CertificateReport>(module, "CertificateReport", "Outcome of verify_certificate")
+        .def_readonly("valid", &CertificateReport::valid)
+        .def_readonly("error", &CertificateReport::error,
+                      "First failed check, by node, empty if the certificate is valid")
+        .def_readonly("first", &CertificateReport::first)
+        .def_readonly("second", &CertificateReport::second)
+        .def_readonly("node_count", &CertificateReport::node_count)
+        .def_readonly("basis_count", &CertificateReport::basis_count)
+        .def("__bool__", [](const CertificateReport& report) { return report.valid; });
+    py::class_<NetHandle>(module, "PetriNet",
+                          "Petri net compiled once for many checks. Pairs proven bisimilar by "
+                          "one check close the same pairs in the later ones.")
+        .def(py::init<const TransitionList&, std::optional<size_t>>(), py::arg("transitions"),
+             py::arg("place_num") = py::none(),
+             "The number of places is the length of the rows of the transitions unless given, "
+             "which a net without transitions needs")
+        .def_property_readonly("place_num", &NetHandle::PlaceNum)
+        .def_property_readonly("transition_num", &NetHandle::TransitionNum)
+        .def_property_readonly("known_pairs", &NetHandle::KnownPairs,
+                               "Number of pairs proven bisimilar so far")
+        .def("check", &NetHandle::Check, "Checks one pair like the module-level check",
+             py::arg("resource_one"), py::arg("resource_two"), py::arg("record_basis") = false,
+             py::arg("threads") = 1, py::arg("max_depth") = 0, py::arg("max_nodes") = 0,
+             py::arg("max_memory") = 0, py::arg("max_seconds") = 0.0, py::arg("cancel") = nullptr,
+             py::arg("progress") = nullptr, py::arg("progress_interval") = 0.5,
+             py::arg("memoize") = true, py::arg("profile") = false, py::arg("trace_depth") = 8,
+             py::arg("previous") = nullptr, py::arg("strategy") = SearchStrategy(),
+             py::arg("certificate") = false)
+        .def("check_many", &NetHandle::CheckMany,
+             "Checks a list of (resource_one, resource_two) pairs on threads in parallel and "
+             "returns their verdicts in the same order, True, False or None if the search was "
+             "stopped. With trees the CheckResult of every pair is returned instead. The limits "
+             "apply to each pair.",
+             py::arg("pairs"), py::arg("threads") = 1, py::arg("trees") = false,
+             py::arg("record_basis") = false, py::arg("max_depth") = 0, py::arg("max_nodes") = 0,
+             py::arg("max_memory") = 0, py::arg("max_seconds") = 0.0, py::arg("cancel") = nullptr,
+             py::arg("memoize") = true, py::arg("strategy") = SearchStrategy())
+        .def("verify_certificate", &NetHandle::Verify,
+             "Verifies a certificate against the net like the module-level verify_certificate",
+             py::arg("path"), py::arg("threads") = 1, py::call_guard<py::gil_scoped_release>());
+    module.def("check", &Check,
+               "Checks bisimilarity of two resources like check_bisimilarity, but keeps the proof "
+               "tree in memory and returns it as a CheckResult instead of writing it.\n\nWith "
+               "profile the stats of the result count the work of the search in detail, and the "
+               "subtrees expanded above trace_depth are kept for CheckResult.write_trace.\n\nGiven the "
+               "previous CheckResult of a slightly different net or pair, the search tries its "
+               "choices first and, if the transitions are the same, reuses its verdicts.\n\nWith "
+               "certificate the tree keeps what CheckResult.write_certificate needs, which "
+               "takes memory for the proofs the tree discards and ignores the pairs proven by "
+               "other checks.",
+               py::arg("resource_one"), py::arg("resource_two"), py::arg("transitions"),
+               py::arg("record_basis") = false, py::arg("threads") = 1, py::arg("max_depth") = 0,
+               py::arg("max_nodes") = 0, py::arg("max_memory") = 0, py::arg("max_seconds") = 0.0,
+               py::arg("cancel") = nullptr, py::arg("progress") = nullptr,
+               py::arg("progress_interval") = 0.5, py::arg("memoize") = true,
+               py::arg("profile") = false, py::arg("trace_depth") = 8,
+               py::arg("previous") = nullptr, py::arg("strategy") = SearchStrategy(),
+               py::arg("certificate") = false);
     module.def("check_bisimilarity", &CheckBisimilarity,
                "A function that checks bisimilarity of two resources on a given Petri net and "
-               "prints the resulting decision tree to a specified path.\n\nOptionally the function "
-               "can approximate a basis of the bisimilarity.");
+               "prints the resulting decision tree to a specified path, compressed with gzip or "
+               "zstd if it ends with .gz or .zst, or in the compact binary format read by TreeFile if it "
+               "ends with .ptree.\n\nOptionally the function "
+               "can approximate a basis of the bisimilarity. With threads > 1 independent subtrees "
+               "are checked in parallel, giving the same result. The tree depends on the timing "
+               "of the threads: with memoize a node expanded in one run may be closed from the "
+               "transposition table in another, and a refutation stops wherever the siblings of "
+               "the failed child were. Only a proof without memoize is the same tree as with one "
+               "thread.\n\nThe search can be "
+               "bounded by its depth, number of created nodes, estimated memory in bytes and time "
+               "in seconds, zero meaning unlimited. If any of the budgets runs out or the check is "
+               "cancelled with a CancellationToken the function returns None and prints the "
+               "partial tree.\n\nThe GIL is released during the search. The progress callback "
+               "receives the number of created nodes, the current depth and the nodes per second, "
+               "at most once per progress_interval seconds.\n\nWith memoize pairs already decided "
+               "elsewhere in the tree are closed without expanding them again. If a stats dict is "
+               "given it is filled with the counters of the search, and with profile also with "
+               "the detailed counters and the time of every phase.\n\nGiven a spill path, proven "
+               "subtrees that assume no pair outside of them are moved to a scratch file at that "
+               "path during the search, which bounds the memory of long checks, and read back "
+               "when the tree is printed. The file is removed afterwards. Spilling cannot be "
+               "combined with record_basis.\n\nThe strategy sets the order of the search: "
+               "iterative deepening and the orders of the children and of the mirroring "
+               "transitions, see SearchStrategy.",
+               py::arg("resource_one"), py::arg("resource_two"), py::arg("transitions"),
+               py::arg("record_basis"), py::arg("path"), py::arg("threads") = 1,
+               py::arg("max_depth") = 0, py::arg("max_nodes") = 0, py::arg("max_memory") = 0,
+               py::arg("max_seconds") = 0.0, py::arg("cancel") = nullptr,
+               py::arg("progress") = nullptr, py::arg("progress_interval") = 0.5,
+               py::arg("memoize") = true, py::arg("stats") = py::none(),
+               py::arg("profile") = false, py::arg("spill") = "",
+               py::arg("strategy") = SearchStrategy());
+    module.def(
+        "verify_certificate",
+        [](const std::string& path, const TransitionList& transitions, size_t threads,
+           std::optional<size_t> place_num) {
+            return VerifyCertificate(path, *MakeNet(transitions, place_num), threads);
+        },
+        "Checks a certificate written by CheckResult.write_certificate against the net in one "
+        "pass over its steps, without searching, replaying subtrees on threads in parallel. "
+        "Returns a CertificateReport, true if the proof holds. Raises if the file is not a "
+        "certificate or is truncated.",
+        py::arg("path"), py::arg("transitions"), py::arg("threads") = 1,
+        py::arg("place_num") = py::none(), py::call_guard<py::gil_scoped_release>());
 }
\ No newline at end of file
@@ -1 +1,2 @@
-from ._core import check_bisimilarity
+from ._core import (check_bisimilarity, check, verify_certificate, CancellationToken,
+                    CertificateReport, CheckResult, PetriNet, TreeFile)
@@ -0,0 +1,393 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "petrinets/certificate.h"
+#include "petrinets/petrinet.h"
+#include "petrinets/pnml.h"
+#include "petrinets/prooftree.h"
+
+namespace {
+
+constexpr const char* kUsage =
+    R"(Usage: BisimilarityGame NET.pnml RESOURCES.csv [RESOURCES.csv ...] [options]
+       BisimilarityGame --verify NET.pnml CERTIFICATE [CERTIFICATE ...] [-r RESOURCES.csv] [-j N]
+
+Checks the resource pairs of every .csv file, written by the UI, for bisimilarity on the net and
+prints a verdict per file: bisimilar, not bisimilar or unknown if a limit stopped the search.
+Pairs proven bisimilar by one check close the same pairs in the later ones.
+
+With --verify, checks certificates written by --certificate against the net instead, replaying
+their steps without searching, and prints valid or invalid with the failed check and the pair
+the certificate proves per file.
+
+Options:
+  -o, --output PATH      write the proof tree, as GraphML compressed if PATH ends with .gz or
+                         .zst, or in the binary format if it ends with .ptree; only with a
+                         single resource file
+  -b, --basis            record an approximation of the basis in the written tree
+  -c, --certificate PATH write a proof certificate if the resources are bisimilar, with the
+                         basis if --basis is given; only with a single resource file
+  -j, --threads N        threads for each check or verification, 1 by default
+      --max-depth N      limit the nested EXPAND steps on a branch
+      --max-nodes N      limit the nodes created by each check
+      --max-memory BYTES limit the estimated memory held by each tree
+      --max-seconds S    limit the time of each check
+      --no-memo          disable the transposition table
+      --deepening N      search with iterative deepening, bounding the EXPAND steps by N more
+                         in every pass
+      --child-order ORDER
+                         order of the children of a node: net, the default, or farthest for
+                         the pairs with the most tokens outside of their intersection first
+      --gamma-order ORDER
+                         order of the mirroring transitions: net, the default, or closest for
+                         the ones whose rows are closest to the mirrored transition first
+      --spill PATH       move the proven subtrees that assume no outer pair to a scratch file
+                         at PATH while checking, removed afterwards; not with --basis
+  -i, --incremental      start each check from the tree of the previous file, for series of
+                         slightly different resources
+  -s, --stats            print the counters and the time of each check
+  -p, --profile          count the work of each check in detail and time its phases, printed
+                         with --stats
+      --trace PATH       write the subtrees expanded near the root as a Chrome trace, viewable
+                         in chrome://tracing or Perfetto; only with a single resource file
+      --trace-depth N    depth down to which subtrees are traced, 8 by default
+      --verify           verify certificates instead of checking resources
+  -r, --resources PATH   with --verify, a resource file whose pair the certificate must prove
+                         in either order, given once for all certificates or once for each in
+                         their order
+  -h, --help             show this message
+
+Exits with 0 once every file is checked, 1 if a file cannot be read, 2 on invalid arguments and
+3 if a certificate is invalid.
+)";
+
+struct Options {
+    std::string net_path;
+    std::vector<std::string> resource_paths;  // certificates with --verify
+    std::vector<std::string> expected;        // resources the certificates prove, with --verify
+    std::string output;
+    std::string certificate;
+    bool verify = false;
+    bool basis = false;
+    size_t threads = 1;
+    SearchLimits limits;
+    SearchStrategy strategy;
+    bool memoize = true;
+    std::string spill;
+    bool incremental = false;
+    bool stats = false;
+    bool profile = false;
+    std::string trace;
+    int trace_depth = 8;
+};
+
+/**
+ * Parses the value of a numeric option, rejecting trailing characters
+ */
+template <class T>
+T ParseNumber(const std::string& option, const std::string& text) {
+    size_t used = 0;
+    T value;
+    try {
+        if constexpr (std::is_floating_point_v<T>) {
+            value = static_cast<T>(std::stod(text, &used));
+        } else {
+            if (!text.empty() && text[0] == '-') {
+                throw std::invalid_argument(text);
+            }
+            value = static_cast<T>(std::stoull(text, &used));
+        }
+    } catch (const std::exception&) {
+        used = 0;
+    }
+    if (used == 0 || used != text.size()) {
+        throw std::invalid_argument("Invalid value " + text + " of " + option);
+    }
+    return value;
+}
+
+Options ParseOptions(int argc, char** argv) {
+    Options options;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value of " + arg);
+            }
+            return argv[++i];
+        };
+        if (arg == "-h" || arg == "--help") {
+            std::cout << kUsage;
+            std::exit(0);
+        } else if (arg == "-o" || arg == "--output") {
+            options.output = value();
+        } else if (arg == "-b" || arg == "--basis") {
+            options.basis = true;
+        } else if (arg == "-c" || arg == "--certificate") {
+            options.certificate = value();
+        } else if (arg == "--verify") {
+            options.verify = true;
+        } else if (arg == "-r" || arg == "--resources") {
+            options.expected.push_back(value());
+        } else if (arg == "-j" || arg == "--threads") {
+            options.threads = std::max<size_t>(1, ParseNumber<size_t>(arg, value()));
+        } else if (arg == "--max-depth") {
+            options.limits.max_depth = ParseNumber<int>(arg, value());
+        } else if (arg == "--max-nodes") {
+            options.limits.max_nodes = ParseNumber<size_t>(arg, value());
+        } else if (arg == "--max-memory") {
+            options.limits.max_memory = ParseNumber<size_t>(arg, value());
+        } else if (arg == "--max-seconds") {
+            options.limits.max_seconds = ParseNumber<double>(arg, value());
+        } else if (arg == "--no-memo") {
+            options.memoize = false;
+        } else if (arg == "--deepening") {
+            options.strategy.deepening_step = ParseNumber<int>(arg, value());
+        } else if (arg == "--child-order") {
+            std::string order = value();
+            if (order == "net") {
+                options.strategy.child_order = ChildOrder::kNet;
+            } else if (order == "farthest") {
+                options.strategy.child_order = ChildOrder::kFarthestFirst;
+            } else {
+                throw std::invalid_argument("Invalid value " + order + " of " + arg);
+            }
+        } else if (arg == "--gamma-order") {
+            std::string order = value();
+            if (order == "net") {
+                options.strategy.gamma_order = GammaOrder::kNet;
+            } else if (order == "closest") {
+                options.strategy.gamma_order = GammaOrder::kClosestFirst;
+            } else {
+                throw std::invalid_argument("Invalid value " + order + " of " + arg);
+            }
+        } else if (arg == "--spill") {
+            options.spill = value();
+        } else if (arg == "-i" || arg == "--incremental") {
+            options.incremental = true;
+        } else if (arg == "-s" || arg == "--stats") {
+            options.stats = true;
+        } else if (arg == "-p" || arg == "--profile") {
+            options.profile = true;
+        } else if (arg == "--trace") {
+            options.trace = value();
+            options.profile = true;
+        } else if (arg == "--trace-depth") {
+            options.trace_depth = ParseNumber<int>(arg, value());
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            throw std::invalid_argument("Unknown option " + arg);
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() < 2) {
+        throw std::invalid_argument(options.verify
+                                        ? "Expected a net and at least one certificate"
+                                        : "Expected a net and at least one resource file");
+    }
+    options.net_path = positional[0];
+    options.resource_paths.assign(positional.begin() + 1, positional.end());
+    if (!options.expected.empty() && !options.verify) {
+        throw std::invalid_argument("--resources needs --verify");
+    }
+    if (options.expected.size() > 1 && options.expected.size() != options.resource_paths.size()) {
+        throw std::invalid_argument("--resources needs one file or one for every certificate");
+    }
+    if (!options.output.empty() && options.resource_paths.size() > 1) {
+        throw std::invalid_argument("--output needs a single resource file");
+    }
+    if (!options.certificate.empty() && options.resource_paths.size() > 1) {
+        throw std::invalid_argument("--certificate needs a single resource file");
+    }
+    if (!options.trace.empty() && options.resource_paths.size() > 1) {
+        throw std::invalid_argument("--trace needs a single resource file");
+    }
+    if (!options.spill.empty() && options.basis) {
+        throw std::invalid_argument("--spill cannot be combined with --basis");
+    }
+    return options;
+}
+
+const char* VerdictName(Verdict verdict) {
+    switch (verdict) {
+        case Verdict::kBisimilar:
+            return "bisimilar";
+        case Verdict::kNotBisimilar:
+            return "not bisimilar";
+        default:
+            return "unknown";
+    }
+}
+
+void PrintProfile(const SearchProfile& profile, const PetriNet& net) {
+    std::cout << "  expand iterations " << profile.expand_iterations << ", backtracks "
+              << profile.backtracks << " (at most " << profile.max_backtracks
+              << " of a node), max depth " << profile.max_depth << "\n"
+              << "  candidates tried " << profile.candidates_tried << ", rejected "
+              << profile.candidates_rejected << ", reduce comparisons "
+              << profile.reduce_comparisons << ", reduce hits " << profile.reduce_hits << "\n"
+              << "  phase seconds:";
+    for (size_t i = 0; i < profile.phase_seconds.size(); ++i) {
+        std::cout << ' ' << PhaseName(static_cast<SearchPhase>(i)) << ' '
+                  << profile.phase_seconds[i];
+    }
+    std::cout << "\n";
+    // The transitions whose candidates cost the most
+    std::vector<size_t> order;
+    for (size_t i = 0; i < profile.transition_tried.size(); ++i) {
+        if (profile.transition_tried[i] > 0) {
+            order.push_back(i);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t left, size_t right) {
+        return profile.transition_tried[left] > profile.transition_tried[right];
+    });
+    order.resize(std::min<size_t>(order.size(), 5));
+    for (size_t i : order) {
+        const Transition& transition = net.GetTransitions()[i];
+        std::cout << "  transition " << transition.id << " (" << transition.label << "): tried "
+                  << profile.transition_tried[i] << ", rejected "
+                  << profile.transition_rejected[i] << "\n";
+    }
+    std::cout << std::flush;
+}
+
+/**
+ * Writes a marking as the places with their tokens, like p1=2 p2=1
+ */
+std::string MarkingText(const std::vector<int>& marking, const std::vector<std::string>& places) {
+    std::string text;
+    for (size_t i = 0; i < marking.size() && i < places.size(); ++i) {
+        if (marking[i] != 0) {
+            text += (text.empty() ? "" : " ") + places[i] + "=" + std::to_string(marking[i]);
+        }
+    }
+    return text.empty() ? "empty" : text;
+}
+
+/**
+ * Verifies every certificate of the options against the net, and against the pair of its
+ * resource file if given, as a valid proof of another pair proves nothing about the resources
+ * @return the exit code, 3 if some certificate is invalid
+ */
+int VerifyCertificates(const Options& options, const PnmlNet& pnml, const PetriNet& net) {
+    int code = 0;
+    for (size_t i = 0; i < options.resource_paths.size(); ++i) {
+        const std::string& path = options.resource_paths[i];
+        CertificateReport report = VerifyCertificate(path, net, options.threads);
+        if (report.valid && !options.expected.empty()) {
+            const std::string& expected =
+                options.expected[options.expected.size() == 1 ? 0 : i];
+            auto [first, second] = ReadResources(expected, pnml.places);
+            if (!((report.first == first && report.second == second) ||
+                  (report.first == second && report.second == first))) {
+                report.valid = false;
+                report.error = "the certificate does not prove the pair of " + expected;
+            }
+        }
+        if (report.valid) {
+            std::cout << path << ": valid, " << report.node_count << " steps" << std::endl;
+        } else {
+            std::cout << path << ": invalid, " << report.error << std::endl;
+            code = 3;
+        }
+        if (!report.first.empty() || !report.second.empty()) {
+            std::cout << "  pair " << MarkingText(report.first, pnml.places) << " ~ "
+                      << MarkingText(report.second, pnml.places) << std::endl;
+        }
+    }
+    return code;
+}
+
+bool EndsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() &&
+           text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    try {
+        options = ParseOptions(argc, argv);
+    } catch (const std::invalid_argument& err) {
+        std::cerr << err.what() << "\n\n" << kUsage;
+        return 2;
+    }
+    try {
+        PnmlNet pnml = ReadPnml(options.net_path);
+        PetriNet net(pnml.transitions, pnml.places.size());
+        if (options.verify) {
+            return VerifyCertificates(options, pnml, net);
+        }
+        SharedMemo shared(net.GetPlaceNum());
+        std::unique_ptr<ProofTree> previous;
+        for (auto&& path : options.resource_paths) {
+            auto [first, second] = ReadResources(path, pnml.places);
+            auto current = std::make_unique<ProofTree>(Multiset(std::move(first)),
+                                                       Multiset(std::move(second)), &net,
+                                                       options.basis, options.threads);
+            ProofTree& tree = *current;
+            tree.SetStrategy(options.strategy);
+            tree.SetCertifiable(!options.certificate.empty());
+            if (previous != nullptr) {
+                tree.Reuse(*previous);
+                previous.reset();
+            }
+            tree.SetLimits(options.limits);
+            tree.SetMemoization(options.memoize);
+            tree.SetSharedMemo(&shared);
+            tree.SetSpilling(options.spill);
+            tree.SetProfiling(options.profile, options.trace.empty() ? 0 : options.trace_depth);
+            Verdict verdict = tree.CheckBisimilarity();
+            std::cout << path << ": " << VerdictName(verdict) << std::endl;
+            if (options.stats) {
+                SearchStats stats = tree.Stats();
+                std::cout << "  nodes created " << stats.nodes_created << ", memo hits "
+                          << stats.memo_hits << ", memo misses " << stats.memo_misses
+                          << ", refuted hits " << stats.refuted_hits << ", peak memory "
+                          << stats.peak_memory << " bytes, " << stats.seconds << " s"
+                          << std::endl;
+                if (!options.spill.empty()) {
+                    std::cout << "  spilled nodes " << stats.spilled_nodes << std::endl;
+                }
+                if (stats.deepening_passes > 0) {
+                    std::cout << "  deepening passes " << stats.deepening_passes << std::endl;
+                }
+                if (options.incremental) {
+                    std::cout << "  reused verdicts " << stats.reused_pairs << ", hinted nodes "
+                              << stats.hinted_nodes << std::endl;
+                }
+                if (stats.profiled) {
+                    PrintProfile(stats.profile, net);
+                }
+            }
+            if (!options.trace.empty()) {
+                tree.WriteTrace(options.trace);
+            }
+            if (!options.output.empty()) {
+                if (EndsWith(options.output, ".ptree")) {
+                    tree.WriteBinary(options.output);
+                } else {
+                    tree.PrintTree(options.output);
+                }
+            }
+            if (!options.certificate.empty() && verdict == Verdict::kBisimilar) {
+                tree.WriteCertificate(options.certificate);
+            }
+            if (options.incremental) {
+                previous = std::move(current);
+            }
+        }
+    } catch (const std::exception& err) {
+        std::cerr << err.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
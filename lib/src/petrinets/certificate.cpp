@@ -0,0 +1,507 @@
+#include "certificate.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include "threadpool.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Proof certificates are written in the native byte order, which must be little-endian"
+#endif
+
+namespace certificate {
+
+bool ReduceStep(const Multiset& first, const Multiset& second, const Multiset& ancestor_first,
+                const Multiset& ancestor_second, bool reversed, Multiset* reduced) {
+    // The temporaries take their rows from the storage of the pair
+    Multiset first_rem = Multiset::SameStorage(first), second_rem = Multiset::SameStorage(first);
+    Multiset intersect = Multiset::SplitIntersection(&first, &second, &first_rem, &second_rem);
+    Multiset ancestor_first_rem = Multiset::SameStorage(first);
+    Multiset ancestor_second_rem = Multiset::SameStorage(first);
+    Multiset ancestor_intersect = Multiset::SplitIntersection(
+        &ancestor_first, &ancestor_second, &ancestor_first_rem, &ancestor_second_rem);
+    // Identical pairs have no remainders and are never below a non-identical one
+    if (ancestor_first_rem.Power() == 0 && ancestor_second_rem.Power() == 0) {
+        return false;
+    }
+    const Multiset& other_first_rem = reversed ? ancestor_second_rem : ancestor_first_rem;
+    const Multiset& other_second_rem = reversed ? ancestor_first_rem : ancestor_second_rem;
+    if (!ancestor_intersect.SubsetOf(intersect) || !other_first_rem.SubsetOf(first_rem) ||
+        !other_second_rem.SubsetOf(second_rem)) {
+        return false;
+    }
+    *reduced = Multiset::ReduceChild(intersect, other_second_rem, second_rem, other_first_rem);
+    return true;
+}
+
+}  // namespace certificate
+
+namespace {
+
+using certificate::kNone;
+using certificate::StepRecord;
+using Pair = std::pair<Multiset, Multiset>;
+
+// Subtrees are replayed in parallel from the first level with this many nodes per thread, which
+// leaves enough tasks to balance uneven subtrees
+constexpr uint64_t kTasksPerThread = 8;
+
+/**
+ * Hashes a pair of markings independently of their order
+ */
+uint64_t PairHash(const Multiset& first, const Multiset& second) {
+    uint64_t first_hash = first.Hash(), second_hash = second.Hash();
+    return (std::min(first_hash, second_hash) * 0x9e3779b97f4a7c15) ^
+           std::max(first_hash, second_hash);
+}
+
+bool SamePair(const Pair& left, const Pair& right) {
+    return (left.first == right.first && left.second == right.second) ||
+           (left.first == right.second && left.second == right.first);
+}
+
+/**
+ * Checks the steps of a certificate in three passes: the shape of the tree, the replay of every
+ * step from its parent, and the leaves closed by earlier nodes. Failures are reported for the
+ * node with the lowest id, whatever the order the threads meet them in.
+ */
+class Verifier {
+public:
+    Verifier(const PetriNet& net, std::vector<StepRecord> steps, Pair root,
+             std::vector<Pair> basis)
+        : net_(net),
+          place_num_(net.GetPlaceNum()),
+          steps_(std::move(steps)),
+          arena_(place_num_),
+          root_(Multiset(root.first, &arena_), Multiset(root.second, &arena_)),
+          basis_found_(std::make_unique<std::atomic<bool>[]>(basis.size())) {
+        // The paths handed to the tasks are released on the threads replaying them
+        arena_.SetConcurrent(true);
+        for (size_t i = 0; i < basis.size(); ++i) {
+            basis_.emplace_back(Multiset(basis[i].first, &arena_),
+                                Multiset(basis[i].second, &arena_));
+            basis_index_.emplace(PairHash(basis_[i].first, basis_[i].second), i);
+        }
+    }
+
+    /**
+     * @return the first failed check, empty if the proof holds
+     */
+    std::string Run(size_t thread_num) {
+        if (!Shape()) {
+            return error_;
+        }
+        uint32_t split_level = UINT32_MAX;
+        for (uint32_t level = 0; thread_num > 1 && level < level_counts_.size(); ++level) {
+            if (level_counts_[level] >= kTasksPerThread * thread_num) {
+                split_level = level;
+                break;
+            }
+        }
+        if (split_level == UINT32_MAX) {
+            Replay(0, nullptr, split_level, {});
+        } else {
+            ThreadPool pool(thread_num - 1);
+            TaskGroup tasks(&pool);
+            Replay(0, &tasks, split_level, {});
+            tasks.Wait();
+        }
+        if (failed_ != kNone) {
+            return error_;
+        }
+        Closures();
+        if (failed_ != kNone) {
+            return error_;
+        }
+        for (size_t i = 0; i < basis_.size(); ++i) {
+            if (!basis_found_[i]) {
+                return "basis pair " + std::to_string(i) + " does not occur in the proof";
+            }
+        }
+        return {};
+    }
+
+private:
+    /**
+     * Derives the level and subtree size of every node from the child counts, and
+     * checks the kind of every step and the nodes it refers to
+     * @return false if the steps do not form a tree
+     */
+    bool Shape() {
+        uint64_t node_count = steps_.size();
+        if (node_count == 0) {
+            Fail(0, "the proof has no root");
+            return false;
+        }
+        level_.assign(node_count, 0);
+        size_.assign(node_count, 0);
+        assumed_.assign(node_count, INT32_MAX);
+        struct Open {
+            uint64_t id;
+            uint64_t remaining;
+        };
+        std::vector<Open> open;  // the ancestors of the current node, by level
+        for (uint64_t id = 0; id < node_count; ++id) {
+            while (!open.empty() && open.back().remaining == 0) {
+                size_[open.back().id] = id - open.back().id;
+                open.pop_back();
+            }
+            const StepRecord& step = steps_[id];
+            if (id > 0) {
+                if (open.empty()) {
+                    Fail(id, "the node is outside of the tree of the root");
+                    return false;
+                }
+                --open.back().remaining;
+            }
+            level_[id] = static_cast<uint32_t>(open.size());
+            if (level_counts_.size() <= level_[id]) {
+                level_counts_.push_back(0);
+            }
+            ++level_counts_[level_[id]];
+
+            bool reduce = step.order == 0 && id > 0;
+            if ((step.order != 0 && (id == 0 || (step.order != 1 && step.order != -1))) ||
+                reduce != (step.reduced != kNone) || step.reversed > 1) {
+                Fail(id, "the step is malformed");
+                return false;
+            }
+            if (reduce) {
+                // A proper ancestor of the parent, which is the last open node
+                uint64_t ancestor = step.reduced;
+                if (ancestor >= id || level_[ancestor] + 1 >= open.size() ||
+                    open[level_[ancestor]].id != ancestor) {
+                    Fail(id, "REDUCE refers to a node that is not an ancestor of the parent");
+                    return false;
+                }
+                assumed_[id] = static_cast<int32_t>(level_[ancestor]);
+            }
+            if (step.witness != kNone) {
+                if (step.witness >= id || step.child_count != 0) {
+                    Fail(id, "only a leaf can refer to an earlier node");
+                    return false;
+                }
+                for (uint64_t node : {step.witness, id}) {
+                    if (slot_of_.emplace(node, slot_of_.size()).second) {
+                        slots_.emplace_back(Multiset(&arena_), Multiset(&arena_));
+                    }
+                }
+            }
+            open.push_back({id, step.child_count});
+        }
+        while (!open.empty()) {
+            if (open.back().remaining != 0) {
+                Fail(open.back().id, "the node misses some of its children");
+                return false;
+            }
+            size_[open.back().id] = node_count - open.back().id;
+            open.pop_back();
+        }
+        return true;
+    }
+
+    /**
+     * Replays the steps of a subtree in preorder, handing the subtrees at the split level to the
+     * tasks if there are any. The pairs are kept in an arena of the call, so a node allocates
+     * nothing once the rows of the released nodes are reused.
+     * @param begin root of the subtree
+     * @param ancestors pairs of the ancestors of begin, by level, in the arena of the verifier
+     */
+    void Replay(uint64_t begin, TaskGroup* tasks, uint32_t split_level,
+                const std::vector<Pair>& ancestors) {
+        MarkingArena arena(place_num_);
+        std::vector<Pair> path;
+        for (auto&& pair : ancestors) {
+            path.emplace_back(Multiset(pair.first, &arena), Multiset(pair.second, &arena));
+        }
+        uint64_t end = begin + size_[begin];
+        for (uint64_t id = begin; id < end;) {
+            if (failed_ < id) {
+                // A lower node failed already, nothing found here would be reported
+                return;
+            }
+            path.resize(level_[id]);
+            if (tasks != nullptr && level_[id] == split_level) {
+                // The task may outlive this call and its arena
+                std::vector<Pair> handed;
+                for (auto&& pair : path) {
+                    handed.emplace_back(Multiset(pair.first, &arena_),
+                                        Multiset(pair.second, &arena_));
+                }
+                tasks->Run([this, id, split_level, handed = std::move(handed)] {
+                    Replay(id, nullptr, split_level, handed);
+                });
+                id += size_[id];
+                continue;
+            }
+            if (!Check(id, &arena, &path)) {
+                return;
+            }
+            ++id;
+        }
+    }
+
+    /**
+     * Recomputes the pair of a node from its parent and checks its step and its children
+     * @param arena arena of the pairs on the path
+     * @param path pairs of the ancestors of the node, by level, extended by the pair of the node
+     * @return false if a check failed
+     */
+    bool Check(uint64_t id, MarkingArena* arena, std::vector<Pair>* path) {
+        const auto& transitions = net_.GetTransitions();
+        const StepRecord& step = steps_[id];
+        Pair pair;
+        if (id == 0) {
+            pair = {Multiset(root_.first, arena), Multiset(root_.second, arena)};
+        } else if (step.order != 0) {
+            if (step.delta < 0 || static_cast<size_t>(step.delta) >= transitions.size() ||
+                step.gamma < 0 || static_cast<size_t>(step.gamma) >= transitions.size()) {
+                Fail(id, "the step uses a transition the net does not have");
+                return false;
+            }
+            const Transition& delta = transitions[step.delta];
+            const Transition& gamma = transitions[step.gamma];
+            if (delta.label_id != gamma.label_id) {
+                Fail(id, "delta and gamma have different labels");
+                return false;
+            }
+            const Pair& parent = (*path)[level_[id] - 1];
+            const Multiset& init = step.order > 0 ? parent.first : parent.second;
+            const Multiset& other = step.order > 0 ? parent.second : parent.first;
+            pair.first = Multiset::WeakTransition(&init, &delta);
+            pair.second = Multiset(arena);
+            if (!Multiset::MirrorTransition(&other, &init, &delta, &gamma, &pair.second)) {
+                Fail(id, "gamma cannot mirror delta");
+                return false;
+            }
+        } else {
+            const Pair& parent = (*path)[level_[id] - 1];
+            const Pair& ancestor = (*path)[level_[step.reduced]];
+            pair.first = parent.first;
+            if (!certificate::ReduceStep(parent.first, parent.second, ancestor.first,
+                                         ancestor.second, step.reversed != 0, &pair.second)) {
+                Fail(id, "the ancestor used by REDUCE is not below the parent");
+                return false;
+            }
+        }
+
+        if (step.child_count > 0) {
+            if (!CheckChildren(id)) {
+                return false;
+            }
+        } else if (!(pair.first == pair.second) && step.witness == kNone &&
+                   !transitions.empty()) {
+            Fail(id, "the leaf is neither an identity nor closed by an earlier node");
+            return false;
+        }
+        if (!basis_.empty()) {
+            auto range = basis_index_.equal_range(PairHash(pair.first, pair.second));
+            for (auto it = range.first; it != range.second; ++it) {
+                if (SamePair(basis_[it->second], pair)) {
+                    basis_found_[it->second] = true;
+                }
+            }
+        }
+        auto slot = slot_of_.find(id);
+        if (slot != slot_of_.end()) {
+            // Every node has its own slot, written by the only thread replaying it into the rows
+            // taken when the shape was checked
+            slots_[slot->second].first = pair.first;
+            slots_[slot->second].second = pair.second;
+        }
+        path->push_back(std::move(pair));
+        return true;
+    }
+
+    /**
+     * Checks that a node is either expanded, with one delta child for every transition in both
+     * orders, or reduced, with a single REDUCE child
+     */
+    bool CheckChildren(uint64_t id) {
+        size_t transition_num = net_.GetTransitions().size();
+        uint64_t child = id + 1;
+        if (steps_[child].order == 0) {
+            if (steps_[id].child_count != 1) {
+                Fail(id, "a reduced node has more than one child");
+                return false;
+            }
+            return true;
+        }
+        if (steps_[id].child_count != 2 * transition_num) {
+            Fail(id, "an expanded node does not answer every transition in both orders");
+            return false;
+        }
+        std::vector<bool> answered(2 * transition_num, false);
+        for (uint32_t i = 0; i < steps_[id].child_count; ++i, child += size_[child]) {
+            const StepRecord& step = steps_[child];
+            if (step.order == 0 || step.delta < 0 ||
+                static_cast<size_t>(step.delta) >= transition_num) {
+                Fail(id, "an expanded node has a child that is not a delta child");
+                return false;
+            }
+            size_t index = 2 * static_cast<size_t>(step.delta) + (step.order > 0 ? 0 : 1);
+            if (answered[index]) {
+                Fail(id, "an expanded node answers a transition twice");
+                return false;
+            }
+            answered[index] = true;
+        }
+        return true;
+    }
+
+    /**
+     * Checks the leaves closed by earlier nodes. A witness has to be finished before the leaf.
+     * If its subtree assumes some of its ancestors through REDUCE, the shallowest of them has to
+     * be an ancestor of the leaf as well, which then assumes it in turn, like a scoped entry of
+     * the transposition table.
+     */
+    void Closures() {
+        // Least level of the ancestors assumed strictly below every node, final once the node
+        // is finished, which happens in the order of the ids for the earlier subtrees
+        std::vector<int32_t> inner(steps_.size(), INT32_MAX);
+        std::vector<uint64_t> open;  // the ancestors of the current node, by level
+        auto finish = [&]() {
+            uint64_t done = open.back();
+            open.pop_back();
+            if (!open.empty()) {
+                int32_t assumed = std::min(inner[done], assumed_[done]);
+                inner[open.back()] = std::min(inner[open.back()], assumed);
+            }
+        };
+        for (uint64_t id = 0; id < steps_.size(); ++id) {
+            while (open.size() > level_[id]) {
+                finish();
+            }
+            uint64_t witness = steps_[id].witness;
+            if (witness != kNone) {
+                if (witness + size_[witness] > id) {
+                    Fail(id, "the leaf is closed by one of its ancestors");
+                    return;
+                }
+                int32_t scope = inner[witness];
+                if (scope < static_cast<int32_t>(level_[witness])) {
+                    if (scope >= static_cast<int32_t>(open.size()) || open[scope] > witness) {
+                        Fail(id, "the leaf is closed by a node assuming a pair that is not an "
+                                 "ancestor of the leaf");
+                        return;
+                    }
+                    inner[id] = scope;
+                }
+                if (!SamePair(slots_[slot_of_.at(id)], slots_[slot_of_.at(witness)])) {
+                    Fail(id, "the leaf is closed by a node with another pair");
+                    return;
+                }
+            }
+            open.push_back(id);
+        }
+    }
+
+    void Fail(uint64_t id, const std::string& message) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (id < failed_) {
+            failed_ = id;
+            error_ = "node " + std::to_string(id) + ": " + message;
+        }
+    }
+
+    const PetriNet& net_;
+    size_t place_num_;
+    std::vector<StepRecord> steps_;
+    MarkingArena arena_;  // rows of the root, the basis, the slots and the paths of the tasks
+    Pair root_;
+    std::vector<Pair> basis_;
+    std::unordered_multimap<uint64_t, size_t> basis_index_;
+    std::unique_ptr<std::atomic<bool>[]> basis_found_;
+    std::vector<uint32_t> level_;
+    std::vector<uint64_t> size_;
+    std::vector<int32_t> assumed_;  // level of the ancestor used by REDUCE, INT32_MAX if none
+    std::vector<uint64_t> level_counts_;
+    // Pairs of the closed leaves and their witnesses, kept after the replay
+    std::unordered_map<uint64_t, size_t> slot_of_;
+    std::vector<Pair> slots_;
+    std::mutex mutex_;
+    std::atomic<uint64_t> failed_{kNone};
+    std::string error_;
+};
+
+}  // namespace
+
+CertificateReport VerifyCertificate(const std::string& path, const PetriNet& net,
+                                    size_t thread_num) {
+    using namespace certificate;
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(std::fopen(path.c_str(), "rb"),
+                                                         &std::fclose);
+    if (file == nullptr) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    auto read_raw = [&](void* data, size_t size) {
+        if (size > 0 && std::fread(data, 1, size, file.get()) != size) {
+            throw std::runtime_error(path + " is truncated");
+        }
+    };
+    Header header{};
+    if (std::fread(&header, 1, sizeof(header), file.get()) != sizeof(header) ||
+        std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error(path + " is not a proof certificate");
+    }
+    if (header.version != kVersion) {
+        throw std::runtime_error(path + " has an unsupported certificate format version");
+    }
+    auto read_marking = [&]() {
+        std::vector<int> marking(header.place_num);
+        read_raw(marking.data(), marking.size() * sizeof(int32_t));
+        return marking;
+    };
+    CertificateReport report;
+    report.first = read_marking();
+    report.second = read_marking();
+    report.node_count = header.node_count;
+    report.basis_count = header.basis_count;
+    if (header.place_num != net.GetPlaceNum() ||
+        header.transition_count != net.GetTransitions().size() ||
+        header.net_hash != net.Fingerprint()) {
+        report.error = "the certificate is for another net";
+        return report;
+    }
+    for (const auto* marking : {&report.first, &report.second}) {
+        for (int value : *marking) {
+            if (value < 0) {
+                report.error = "the root pair has a negative marking";
+                return report;
+            }
+        }
+    }
+
+    // Read in chunks, so that a corrupted count fails on the end of the file instead of
+    // allocating for it
+    constexpr uint64_t kChunk = 1 << 16;
+    std::vector<StepRecord> steps;
+    for (uint64_t read = 0; read < header.node_count;) {
+        uint64_t count = std::min(kChunk, header.node_count - read);
+        steps.resize(read + count);
+        read_raw(steps.data() + read, count * sizeof(StepRecord));
+        read += count;
+    }
+    std::vector<Pair> basis;
+    for (uint64_t i = 0; i < header.basis_count; ++i) {
+        Multiset first(read_marking());
+        Multiset second(read_marking());
+        basis.emplace_back(std::move(first), std::move(second));
+    }
+    if (std::fgetc(file.get()) != EOF) {
+        throw std::runtime_error(path + " is corrupted");
+    }
+    file.reset();
+
+    Verifier verifier(net, std::move(steps),
+                      {Multiset(report.first), Multiset(report.second)}, std::move(basis));
+    report.error = verifier.Run(std::max<size_t>(thread_num, 1));
+    report.valid = report.error.empty();
+    return report;
+}
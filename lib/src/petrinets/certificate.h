@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "petrinet.h"
+
+/**
+ * Proof certificate format
+ *
+ * A certificate holds the steps of a proof of bisimilarity without the markings they produce,
+ * which the verifier recomputes from the root. All numbers are little-endian:
+ *   header | root first marking | root second marking | steps | basis
+ *
+ * Steps are numbered in preorder, so the subtree of a node is a contiguous range starting at it
+ * and every node is known from its parent and its step. Markings are 32-bit integers per place,
+ * basis pairs are packed like the root pair. A leaf either has an identical pair or refers to an
+ * earlier node with the same pair, in either order. The subtree of that node may assume pairs of
+ * its ancestors through REDUCE only if the shallowest of them is an ancestor of the leaf too.
+ */
+namespace certificate {
+
+constexpr char kMagic[8] = {'P', 'N', 'C', 'E', 'R', 'T', '\r', '\n'};
+constexpr uint32_t kVersion = 1;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t place_num;
+    uint32_t transition_count;
+    uint32_t reserved;
+    uint64_t net_hash;  // PetriNet::Fingerprint of the net the proof is for
+    uint64_t node_count;
+    uint64_t basis_count;
+};
+
+struct StepRecord {
+    uint64_t reduced;  // ancestor the parent was compared with by REDUCE, kNone for other nodes
+    uint64_t witness;  // earlier node proving the pair of a leaf, kNone if none
+    int32_t delta;     // transition index, -1 if the node is not a delta child
+    int32_t gamma;
+    uint32_t child_count;
+    int8_t order;      // 1 - rs, 0 - REDUCE child or root, -1 - sr
+    uint8_t reversed;  // REDUCE took the pair of the ancestor in the (second, first) order
+    uint8_t reserved[2];
+};
+
+constexpr uint64_t kNone = UINT64_MAX;
+
+static_assert(sizeof(Header) == 48, "The header layout is part of the format");
+static_assert(sizeof(StepRecord) == 32, "The step layout is part of the format");
+
+/**
+ * REDUCE step of a pair by the pair of an ancestor, as taken by ProofTree
+ * @param reversed take the pair of the ancestor in the (second, first) order
+ * @param reduced second marking of the REDUCE child, written if the step applies
+ * @return true if the ancestor is below the pair in that order
+ */
+bool ReduceStep(const Multiset& first, const Multiset& second, const Multiset& ancestor_first,
+                const Multiset& ancestor_second, bool reversed, Multiset* reduced);
+
+}  // namespace certificate
+
+/**
+ * Outcome of verifying a certificate
+ */
+struct CertificateReport {
+    bool valid = false;
+    std::string error;  // first failed check, by node, empty if valid
+    std::vector<int> first, second;  // the pair proven bisimilar
+    uint64_t node_count = 0;
+    uint64_t basis_count = 0;
+};
+
+/**
+ * Checks a certificate written by ProofTree::WriteCertificate without searching. Every step is
+ * replayed once from the root pair, the subtrees below some level in parallel, and the leaves
+ * closed by earlier nodes are matched with them afterwards.
+ * @param path path to the certificate
+ * @param net net the certificate is checked against
+ * @param thread_num number of threads replaying subtrees, 1 for a sequential check
+ * @return the verdict, invalid with the first failed check if the proof does not hold
+ * @throws std::runtime_error if the file cannot be read or is not a certificate
+ */
+CertificateReport VerifyCertificate(const std::string& path, const PetriNet& net,
+                                    size_t thread_num = 1);
@@ -0,0 +1,82 @@
+#include "graphml.h"
+
+GraphMLWriter::GraphMLWriter(const std::string& path, size_t place_num,
+                             std::vector<std::string> transitions)
+    : output_(OutputStream::Open(path)),
+      place_num_(place_num),
+      transitions_(std::move(transitions)) {
+    output_->Write(
+        R""""(<?xml version="1.0" encoding="UTF-8"?><graphml xmlns="http://graphml.graphdrawing.org/xmlns"><graph id="GameTree" edgedefault="directed">)"""");
+}
+
+void GraphMLWriter::WriteNode(const GraphMLNode& node) {
+    output_->Write("<node id=\"");
+    output_->WriteInt(static_cast<int64_t>(node.id));
+    output_->Write("\" first=\"");
+    WriteMarking(node.first);
+    output_->Write("\" second=\"");
+    WriteMarking(node.second);
+    output_->Write('"');
+    if (node.order != 0) {
+        output_->Write(" delta=\"");
+        output_->WriteEscaped(transitions_[node.delta]);
+        output_->Write("\" gamma=\"");
+        output_->WriteEscaped(transitions_[node.gamma]);
+        output_->Write(node.order > 0 ? "\" order=\"direct\"" : "\" order=\"reverse\"");
+    } else if (node.reduced >= 0) {
+        output_->Write(" reduced=\"");
+        output_->WriteInt(node.reduced);
+        output_->Write('"');
+    }
+    if (node.memo != 0) {
+        output_->Write(node.memo > 0 ? " memo=\"proven\"" : " memo=\"refuted\"");
+    }
+    if (node.terminal) {
+        output_->Write(node.success ? " terminal=\"SUCCESS\"" : " terminal=\"FAIL\"");
+    }
+    output_->Write("/>");
+}
+
+void GraphMLWriter::WriteEdge(uint64_t source, uint64_t target) {
+    output_->Write("<edge source=\"");
+    output_->WriteInt(static_cast<int64_t>(source));
+    output_->Write("\" target=\"");
+    output_->WriteInt(static_cast<int64_t>(target));
+    output_->Write("\"/>");
+}
+
+void GraphMLWriter::EndGraph() {
+    output_->Write("</graph>");
+}
+
+void GraphMLWriter::BeginBasis() {
+    output_->Write("<basis>");
+    basis_started_ = true;
+}
+
+void GraphMLWriter::WriteBasisPair(const int* first, const int* second) {
+    output_->Write("<pair first=\"");
+    WriteMarking(first);
+    output_->Write("\" second=\"");
+    WriteMarking(second);
+    output_->Write("\"/>");
+}
+
+void GraphMLWriter::Close() {
+    if (basis_started_) {
+        output_->Write("</basis>");
+    }
+    output_->Write("</graphml>");
+    output_->Close();
+}
+
+void GraphMLWriter::WriteMarking(const int* marking) {
+    output_->Write('[');
+    for (size_t i = 0; i < place_num_; ++i) {
+        if (i != 0) {
+            output_->Write(", ");
+        }
+        output_->WriteInt(marking[i]);
+    }
+    output_->Write(']');
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "outputstream.h"
+
+/**
+ * Attributes of a proof tree node as written to GraphML
+ */
+struct GraphMLNode {
+    uint64_t id = 0;
+    const int* first = nullptr;
+    const int* second = nullptr;
+    int64_t delta = -1;     // transition index, -1 if the node is not a delta child
+    int64_t gamma = -1;
+    int order = 0;          // 1 - rs, 0 - none, -1 - sr
+    int64_t reduced = -1;   // id of the ancestor used by REDUCE, -1 if none
+    int memo = 0;           // 1 - closed as proven, 0 - none, -1 - closed as refuted
+    bool terminal = false;  // the node has no children
+    bool success = false;   // the terminal node is closed
+};
+
+/**
+ * Streaming writer of proof trees in the GraphML format read by ui/qtui/io/tree.py
+ */
+class GraphMLWriter {
+public:
+    /**
+     * Opens the file and writes the beginning of the graph
+     * @param path path to the file, compressed with gzip or zstd if it ends with .gz or .zst
+     * @param place_num number of places in the markings
+     * @param transitions descriptions of the transitions by index, as Transition::ToString
+     */
+    GraphMLWriter(const std::string& path, size_t place_num,
+                  std::vector<std::string> transitions);
+
+    void WriteNode(const GraphMLNode& node);
+
+    void WriteEdge(uint64_t source, uint64_t target);
+
+    void EndGraph();
+
+    /**
+     * Starts the basis after the graph, its pairs follow
+     */
+    void BeginBasis();
+
+    void WriteBasisPair(const int* first, const int* second);
+
+    /**
+     * Ends the document and closes the file
+     */
+    void Close();
+
+private:
+    void WriteMarking(const int* marking);
+
+    std::unique_ptr<OutputStream> output_;
+    size_t place_num_;
+    std::vector<std::string> transitions_;
+    bool basis_started_ = false;
+};
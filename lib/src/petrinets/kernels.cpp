@@ -0,0 +1,148 @@
+#include "kernels.h"
+#include <algorithm>
+
+#if !defined(BISIMILARITY_NO_SIMD) && defined(__GNUC__) && defined(__x86_64__)
+#define BISIMILARITY_AVX2
+#include <immintrin.h>
+#endif
+
+namespace {
+
+bool SubsetOfScalar(const int* left, const int* right, size_t width) {
+    return DispatchWidth(width, [&](auto width) {
+        bool subset = true;
+        for (size_t i = 0; i < width; ++i) {
+            subset &= left[i] <= right[i];
+        }
+        return subset;
+    });
+}
+
+bool EqualScalar(const int* left, const int* right, size_t width) {
+    return DispatchWidth(width, [&](auto width) {
+        bool equal = true;
+        for (size_t i = 0; i < width; ++i) {
+            equal &= left[i] == right[i];
+        }
+        return equal;
+    });
+}
+
+uint64_t SplitIntersectionScalar(const int* left, const int* right, int* intersect, int* left_rem,
+                                 int* right_rem, size_t width) {
+    return DispatchWidth(width, [&](auto width) {
+        uint64_t power = 0;
+        for (size_t i = 0; i < width; ++i) {
+            intersect[i] = std::min(left[i], right[i]);
+            left_rem[i] = left[i] - intersect[i];
+            right_rem[i] = right[i] - intersect[i];
+            power += intersect[i];
+        }
+        return power;
+    });
+}
+
+uint64_t ReduceChildScalar(const int* intersect, const int* other_second_rem,
+                           const int* second_rem, const int* first_rem, int* res, size_t width) {
+    return DispatchWidth(width, [&](auto width) {
+        uint64_t power = 0;
+        for (size_t i = 0; i < width; ++i) {
+            res[i] = intersect[i] + std::max(0, other_second_rem[i] - second_rem[i]) + first_rem[i];
+            power += res[i];
+        }
+        return power;
+    });
+}
+
+#ifdef BISIMILARITY_AVX2
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+AVX2_TARGET inline __m256i Load(const int* ptr) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+}
+
+AVX2_TARGET inline void Store(int* ptr, __m256i value) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(ptr), value);
+}
+
+/**
+ * Adds eight 32-bit lanes to four 64-bit accumulators, so that the power never overflows
+ */
+AVX2_TARGET inline __m256i AddWide(__m256i acc, __m256i value) {
+    acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(value)));
+    return _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(value, 1)));
+}
+
+AVX2_TARGET inline uint64_t HorizontalSum(__m256i acc) {
+    __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    return static_cast<uint64_t>(_mm_cvtsi128_si64(sum)) +
+           static_cast<uint64_t>(_mm_extract_epi64(sum, 1));
+}
+
+AVX2_TARGET bool SubsetOfAvx2(const int* left, const int* right, size_t width) {
+    __m256i greater = _mm256_setzero_si256();
+    for (size_t i = 0; i < width; i += 8) {
+        greater = _mm256_or_si256(greater, _mm256_cmpgt_epi32(Load(left + i), Load(right + i)));
+    }
+    return _mm256_testz_si256(greater, greater);
+}
+
+AVX2_TARGET bool EqualAvx2(const int* left, const int* right, size_t width) {
+    __m256i diff = _mm256_setzero_si256();
+    for (size_t i = 0; i < width; i += 8) {
+        diff = _mm256_or_si256(diff, _mm256_xor_si256(Load(left + i), Load(right + i)));
+    }
+    return _mm256_testz_si256(diff, diff);
+}
+
+AVX2_TARGET uint64_t SplitIntersectionAvx2(const int* left, const int* right, int* intersect,
+                                           int* left_rem, int* right_rem, size_t width) {
+    __m256i power = _mm256_setzero_si256();
+    for (size_t i = 0; i < width; i += 8) {
+        __m256i l = Load(left + i), r = Load(right + i);
+        __m256i m = _mm256_min_epi32(l, r);
+        Store(intersect + i, m);
+        Store(left_rem + i, _mm256_sub_epi32(l, m));
+        Store(right_rem + i, _mm256_sub_epi32(r, m));
+        power = AddWide(power, m);
+    }
+    return HorizontalSum(power);
+}
+
+AVX2_TARGET uint64_t ReduceChildAvx2(const int* intersect, const int* other_second_rem,
+                                     const int* second_rem, const int* first_rem, int* res,
+                                     size_t width) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i power = zero;
+    for (size_t i = 0; i < width; i += 8) {
+        __m256i extra =
+            _mm256_max_epi32(_mm256_sub_epi32(Load(other_second_rem + i), Load(second_rem + i)),
+                             zero);
+        __m256i v = _mm256_add_epi32(_mm256_add_epi32(Load(intersect + i), extra),
+                                     Load(first_rem + i));
+        Store(res + i, v);
+        power = AddWide(power, v);
+    }
+    return HorizontalSum(power);
+}
+
+#undef AVX2_TARGET
+
+#endif
+
+MultisetKernels SelectKernels() {
+#ifdef BISIMILARITY_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return {SubsetOfAvx2, EqualAvx2, SplitIntersectionAvx2, ReduceChildAvx2, "avx2"};
+    }
+#endif
+    return {SubsetOfScalar, EqualScalar, SplitIntersectionScalar, ReduceChildScalar, "scalar"};
+}
+
+}  // namespace
+
+const MultisetKernels& MultisetKernels::Get() {
+    static const MultisetKernels kernels = SelectKernels();
+    return kernels;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * Calls the kernel with a compile-time width for the specialized row widths
+ * @param width row width
+ * @param kernel generic callable taking the width
+ * @return result of the kernel
+ */
+template <class Kernel>
+inline auto DispatchWidth(size_t width, Kernel&& kernel) {
+    switch (width) {
+        case 8:
+            return kernel(std::integral_constant<size_t, 8>{});
+        case 16:
+            return kernel(std::integral_constant<size_t, 16>{});
+        case 32:
+            return kernel(std::integral_constant<size_t, 32>{});
+        default:
+            return kernel(width);
+    }
+}
+
+/**
+ * Element-wise kernels over zero-padded marking rows
+ *
+ * All rows have a width that is a multiple of 8, so the vectorized versions never need a scalar
+ * tail. The implementation is picked once for the running CPU, falling back to scalar loops.
+ */
+struct MultisetKernels {
+    /**
+     * Checks that every element of left is not greater than the one of right
+     */
+    bool (*subset_of)(const int* left, const int* right, size_t width);
+
+    bool (*equal)(const int* left, const int* right, size_t width);
+
+    /**
+     * Splits two rows into their intersection and remainders
+     * @return power of the intersection
+     */
+    uint64_t (*split_intersection)(const int* left, const int* right, int* intersect,
+                                   int* left_rem, int* right_rem, size_t width);
+
+    /**
+     * Computes intersect + max(0, other_second_rem - second_rem) + first_rem
+     * @return power of the result
+     */
+    uint64_t (*reduce_child)(const int* intersect, const int* other_second_rem,
+                             const int* second_rem, const int* first_rem, int* res, size_t width);
+
+    /**
+     * Name of the selected implementation, "avx2" or "scalar"
+     */
+    const char* name;
+
+    /**
+     * Kernels for the running CPU, selected on the first call
+     */
+    static const MultisetKernels& Get();
+};
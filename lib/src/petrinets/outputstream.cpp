@@ -0,0 +1,217 @@
+#include "outputstream.h"
+#include <charconv>
+#include <cstdio>
+#include <stdexcept>
+
+#ifdef BISIMILARITY_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef BISIMILARITY_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+constexpr size_t kBufferSize = size_t{1} << 20;
+
+bool EndsWith(const std::string& text, std::string_view suffix) {
+    return text.size() >= suffix.size() &&
+           text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+class FileStream : public OutputStream {
+public:
+    explicit FileStream(const std::string& path) : OutputStream(kBufferSize) {
+        file_ = std::fopen(path.c_str(), "wb");
+        if (file_ == nullptr) {
+            throw std::runtime_error("Cannot open " + path + " for writing");
+        }
+    }
+
+    ~FileStream() override {
+        if (file_ != nullptr) {
+            std::fclose(file_);
+        }
+    }
+
+protected:
+    void Sink(const char* data, size_t size) override {
+        if (std::fwrite(data, 1, size, file_) != size) {
+            throw std::runtime_error("Failed to write the output file");
+        }
+    }
+
+    void Finish() override {
+        int status = std::fclose(file_);
+        file_ = nullptr;
+        if (status != 0) {
+            throw std::runtime_error("Failed to close the output file");
+        }
+    }
+
+    FILE* file_ = nullptr;
+};
+
+#ifdef BISIMILARITY_WITH_ZLIB
+
+class GzipStream : public OutputStream {
+public:
+    explicit GzipStream(const std::string& path) : OutputStream(kBufferSize) {
+        file_ = gzopen(path.c_str(), "wb6");
+        if (file_ == nullptr) {
+            throw std::runtime_error("Cannot open " + path + " for writing");
+        }
+    }
+
+    ~GzipStream() override {
+        if (file_ != nullptr) {
+            gzclose(file_);
+        }
+    }
+
+protected:
+    void Sink(const char* data, size_t size) override {
+        if (gzwrite(file_, data, static_cast<unsigned>(size)) != static_cast<int>(size)) {
+            throw std::runtime_error("Failed to write the compressed output file");
+        }
+    }
+
+    void Finish() override {
+        int status = gzclose(file_);
+        file_ = nullptr;
+        if (status != Z_OK) {
+            throw std::runtime_error("Failed to close the compressed output file");
+        }
+    }
+
+private:
+    gzFile file_ = nullptr;
+};
+
+#endif
+
+#ifdef BISIMILARITY_WITH_ZSTD
+
+class ZstdStream : public FileStream {
+public:
+    explicit ZstdStream(const std::string& path)
+        : FileStream(path), context_(ZSTD_createCCtx()), output_(ZSTD_CStreamOutSize()) {
+        if (context_ == nullptr) {
+            throw std::runtime_error("Cannot create a zstd context");
+        }
+    }
+
+    ~ZstdStream() override {
+        ZSTD_freeCCtx(context_);
+    }
+
+protected:
+    void Sink(const char* data, size_t size) override {
+        Compress(data, size, ZSTD_e_continue);
+    }
+
+    void Finish() override {
+        Compress(nullptr, 0, ZSTD_e_end);
+        FileStream::Finish();
+    }
+
+private:
+    void Compress(const char* data, size_t size, ZSTD_EndDirective mode) {
+        ZSTD_inBuffer input{data, size, 0};
+        bool done = false;
+        while (!done) {
+            ZSTD_outBuffer output{output_.data(), output_.size(), 0};
+            size_t remaining = ZSTD_compressStream2(context_, &output, &input, mode);
+            if (ZSTD_isError(remaining)) {
+                throw std::runtime_error(std::string("zstd compression failed: ") +
+                                         ZSTD_getErrorName(remaining));
+            }
+            FileStream::Sink(output_.data(), output.pos);
+            done = mode == ZSTD_e_end ? remaining == 0 : input.pos == input.size;
+        }
+    }
+
+    ZSTD_CCtx* context_;
+    std::vector<char> output_;
+};
+
+#endif
+
+}  // namespace
+
+std::unique_ptr<OutputStream> OutputStream::Open(const std::string& path) {
+    if (EndsWith(path, ".gz")) {
+#ifdef BISIMILARITY_WITH_ZLIB
+        return std::make_unique<GzipStream>(path);
+#else
+        throw std::runtime_error("This build does not support gzip output");
+#endif
+    }
+    if (EndsWith(path, ".zst")) {
+#ifdef BISIMILARITY_WITH_ZSTD
+        return std::make_unique<ZstdStream>(path);
+#else
+        throw std::runtime_error("This build does not support zstd output");
+#endif
+    }
+    return std::make_unique<FileStream>(path);
+}
+
+OutputStream::OutputStream(size_t buffer_size) : buffer_(buffer_size) {
+}
+
+void OutputStream::Write(std::string_view text) {
+    while (!text.empty()) {
+        if (used_ == buffer_.size()) {
+            FlushBuffer();
+        }
+        size_t size = std::min(text.size(), buffer_.size() - used_);
+        std::copy(text.begin(), text.begin() + size, buffer_.begin() + used_);
+        used_ += size;
+        text.remove_prefix(size);
+    }
+}
+
+void OutputStream::WriteInt(int64_t value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    Write(std::string_view(digits, result.ptr - digits));
+}
+
+void OutputStream::WriteEscaped(std::string_view text) {
+    for (char c : text) {
+        switch (c) {
+            case '&':
+                Write("&amp;");
+                break;
+            case '<':
+                Write("&lt;");
+                break;
+            case '>':
+                Write("&gt;");
+                break;
+            case '"':
+                Write("&quot;");
+                break;
+            default:
+                Write(c);
+        }
+    }
+}
+
+void OutputStream::Close() {
+    if (closed_) {
+        return;
+    }
+    closed_ = true;
+    FlushBuffer();
+    Finish();
+}
+
+void OutputStream::FlushBuffer() {
+    if (used_ > 0) {
+        Sink(buffer_.data(), used_);
+        used_ = 0;
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Buffered output file
+ *
+ * Text is gathered in a large buffer and handed to the file in big blocks. Paths ending with
+ * .gz or .zst are compressed with gzip or zstd, if the build supports them.
+ */
+class OutputStream {
+public:
+    /**
+     * Opens a file for writing, picking the compression from its extension
+     * @param path path to the file
+     * @return the opened stream
+     * @throws std::runtime_error if the file cannot be opened or the compression is not supported
+     */
+    static std::unique_ptr<OutputStream> Open(const std::string& path);
+
+    OutputStream(const OutputStream&) = delete;
+    OutputStream& operator=(const OutputStream&) = delete;
+
+    virtual ~OutputStream() = default;
+
+    inline void Write(char c) {
+        if (used_ == buffer_.size()) {
+            FlushBuffer();
+        }
+        buffer_[used_++] = c;
+    }
+
+    void Write(std::string_view text);
+
+    /**
+     * Writes the decimal representation of an integer without allocating
+     */
+    void WriteInt(int64_t value);
+
+    /**
+     * Writes text escaping the characters that are special in XML attributes
+     */
+    void WriteEscaped(std::string_view text);
+
+    /**
+     * Flushes the buffer and finishes the file
+     * @throws std::runtime_error if writing fails
+     */
+    void Close();
+
+protected:
+    explicit OutputStream(size_t buffer_size);
+
+    /**
+     * Writes a block of data to the underlying file
+     */
+    virtual void Sink(const char* data, size_t size) = 0;
+
+    /**
+     * Finishes the compressed stream and closes the file
+     */
+    virtual void Finish() = 0;
+
+private:
+    void FlushBuffer();
+
+    std::vector<char> buffer_;
+    size_t used_ = 0;
+    bool closed_ = false;
+};
@@ -1,31 +1,205 @@
 #include "petrinet.h"
 #include <utility>
 #include <algorithm>
+#include <stdexcept>
 
-Multiset::Multiset(size_t place_num) : arr_(place_num) {
+MarkingArena::MarkingArena(size_t place_num)
+    : place_num_(place_num), width_(Multiset::RowWidth(place_num)) {
+}
+
+int* MarkingArena::Allocate() {
+    std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+    if (concurrent_) {
+        lock.lock();
+    }
+    int* row;
+    if (!free_rows_.empty()) {
+        row = free_rows_.back();
+        free_rows_.pop_back();
+    } else {
+        if (slab_used_ == kRowsPerSlab) {
+            slabs_.push_back(std::make_unique<int[]>(width_ * kRowsPerSlab));
+            ++slab_num_;
+            slab_used_ = 0;
+        }
+        row = slabs_.back().get() + width_ * slab_used_++;
+    }
+    if (lock.owns_lock()) {
+        lock.unlock();
+    }
+    std::fill(row, row + width_, 0);
+    return row;
+}
+
+void MarkingArena::Release(int* row) {
+    std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+    if (concurrent_) {
+        lock.lock();
+    }
+    free_rows_.push_back(row);
+}
+
+void MarkingArena::SetConcurrent(bool concurrent) {
+    concurrent_ = concurrent;
+}
+
+size_t MarkingArena::Length() const {
+    return place_num_;
+}
+
+size_t MarkingArena::Width() const {
+    return width_;
+}
+
+size_t MarkingArena::AllocatedBytes() const {
+    return slab_num_ * kRowsPerSlab * width_ * sizeof(int);
+}
+
+size_t Multiset::RowWidth(size_t place_num) {
+    if (place_num <= 8) {
+        return 8;
+    }
+    if (place_num <= 16) {
+        return 16;
+    }
+    if (place_num <= 32) {
+        return 32;
+    }
+    return (place_num + 7) / 8 * 8;
+}
+
+Multiset::Multiset(size_t place_num) : Multiset(nullptr, place_num) {
+}
+
+Multiset::Multiset(MarkingArena* arena) : Multiset(arena, arena->Length()) {
+}
+
+Multiset::Multiset(MarkingArena* arena, size_t place_num)
+    : arena_(arena), length_(place_num), width_(RowWidth(place_num)) {
+    if (arena_ != nullptr) {
+        // A shorter row would be filled past its end into the next row of the slab
+        if (place_num != arena_->Length()) {
+            throw std::invalid_argument("A multiset of " + std::to_string(place_num) +
+                                        " places does not fit an arena of " +
+                                        std::to_string(arena_->Length()) + " places");
+        }
+        arr_ = arena_->Allocate();
+    } else {
+        arr_ = new int[width_]();
+    }
+}
+
+Multiset::Multiset(std::vector<int> arr) : Multiset(arr.size()) {
+    std::copy(arr.begin(), arr.end(), arr_);
+    for (int x : arr) {
+        power_ += x;
+    }
+}
+
+Multiset::Multiset(const Multiset& other, MarkingArena* arena) : Multiset(arena, other.length_) {
+    std::copy(other.arr_, other.arr_ + width_, arr_);
+    power_ = other.power_;
+}
+
+Multiset::Multiset(const Multiset& other) : Multiset(other, other.arena_) {
+}
+
+Multiset::Multiset(Multiset&& other) noexcept
+    : arr_(other.arr_),
+      arena_(other.arena_),
+      length_(other.length_),
+      width_(other.width_),
+      power_(other.power_) {
+    other.arr_ = nullptr;
+}
+
+Multiset& Multiset::operator=(const Multiset& other) {
+    if (this == &other) {
+        return *this;
+    }
+    if (arr_ == nullptr) {
+        *this = Multiset(other, arena_ != nullptr ? arena_ : other.arena_);
+        return *this;
+    }
+    if (length_ != other.length_) {
+        throw std::invalid_argument("Cannot assign a multiset of " +
+                                    std::to_string(other.length_) + " places to one of " +
+                                    std::to_string(length_) + " places");
+    }
+    std::copy(other.arr_, other.arr_ + width_, arr_);
+    power_ = other.power_;
+    return *this;
+}
+
+Multiset& Multiset::operator=(Multiset&& other) noexcept {
+    std::swap(arr_, other.arr_);
+    std::swap(arena_, other.arena_);
+    length_ = other.length_;
+    width_ = other.width_;
+    power_ = other.power_;
+    return *this;
+}
+
+Multiset::~Multiset() {
+    if (arr_ == nullptr) {
+        return;
+    }
+    if (arena_ != nullptr) {
+        arena_->Release(arr_);
+    } else {
+        delete[] arr_;
+    }
+}
+
+Multiset Multiset::SameStorage(const Multiset& other) {
+    return Multiset(other.arena_, other.length_);
 }
 
 Multiset Multiset::WeakTransition(const Multiset* init, const Transition* delta) {
-    Multiset res(init->Length());
-    for (int i = 0; i < res.Length(); ++i) {
-        res.arr_[i] = std::max(init->arr_[i], delta->before.arr_[i]) - delta->before.arr_[i] +
-                      delta->after.arr_[i];
-        res.power_ += res.arr_[i];
+    // max(init, before) - before + after differs from init only on the supports of delta
+    Multiset res(*init);
+    const int* before = delta->before.arr_;
+    const int* after = delta->after.arr_;
+    int64_t change = 0;
+    for (uint32_t place : delta->before_support) {
+        int value = std::max(res.arr_[place] - before[place], 0);
+        change += value - res.arr_[place];
+        res.arr_[place] = value;
+    }
+    for (uint32_t place : delta->after_support) {
+        res.arr_[place] += after[place];
+        change += after[place];
     }
+    res.power_ = init->power_ + change;
     return res;
 }
 
 bool Multiset::MirrorTransition(const Multiset* init, const Multiset* prev, const Transition* delta,
                                 const Transition* gamma, Multiset* res) {
-    for (int i = 0; i < res->Length(); ++i) {
-        int tmp = std::max(delta->before.arr_[i] - prev->arr_[i], 0) + init->arr_[i] -
-                  gamma->before.arr_[i];
-        if (tmp < 0) {
+    // max(delta_before - prev, 0) + init - gamma_before + gamma_after, which can only go below
+    // zero on the before support of gamma
+    std::copy(init->arr_, init->arr_ + init->width_, res->arr_);
+    const int* delta_before = delta->before.arr_;
+    const int* gamma_before = gamma->before.arr_;
+    const int* gamma_after = gamma->after.arr_;
+    int64_t change = 0;
+    for (uint32_t place : delta->before_support) {
+        int missing = std::max(delta_before[place] - prev->arr_[place], 0);
+        res->arr_[place] += missing;
+        change += missing;
+    }
+    for (uint32_t place : gamma->before_support) {
+        res->arr_[place] -= gamma_before[place];
+        if (res->arr_[place] < 0) {
             return false;
         }
-        res->arr_[i] = tmp + gamma->after.arr_[i];
-        res->power_ += res->arr_[i];
+        change -= gamma_before[place];
     }
+    for (uint32_t place : gamma->after_support) {
+        res->arr_[place] += gamma_after[place];
+        change += gamma_after[place];
+    }
+    res->power_ = init->power_ + change;
     return true;
 }
 
@@ -33,64 +207,71 @@ bool Multiset::operator==(const Multiset& other) const {
     if (power_ != other.power_) {
         return false;
     }
-    for (int i = 0; i < Length(); ++i) {
-        if (arr_[i] != other.arr_[i]) {
-            return false;
-        }
-    }
-    return true;
+    return MultisetKernels::Get().equal(arr_, other.arr_, width_);
 }
 
 Multiset Multiset::SplitIntersection(const Multiset* left, const Multiset* right,
                                      Multiset* left_rem, Multiset* right_rem) {
-    Multiset intersect(left->Length());
-    for (int i = 0; i < left->Length(); ++i) {
-        intersect.arr_[i] = std::min(left->arr_[i], right->arr_[i]);
-        intersect.power_ += intersect.arr_[i];
-        left_rem->arr_[i] = left->arr_[i] - intersect.arr_[i];
-        left_rem->power_ += left_rem->arr_[i];
-        right_rem->arr_[i] = right->arr_[i] - intersect.arr_[i];
-        right_rem->power_ += right_rem->arr_[i];
-    }
+    Multiset intersect = SameStorage(*left);
+    intersect.power_ = MultisetKernels::Get().split_intersection(
+        left->arr_, right->arr_, intersect.arr_, left_rem->arr_, right_rem->arr_, left->width_);
+    left_rem->power_ = left->power_ - intersect.power_;
+    right_rem->power_ = right->power_ - intersect.power_;
     return intersect;
 }
 
 size_t Multiset::Length() const {
-    return arr_.size();
+    return length_;
 }
 
-Multiset Multiset::ReduceChild(const Multiset& intersect, const Multiset& other_second_rem,
-                               const Multiset& second_rem, const Multiset& first_rem) {
-    Multiset res(intersect.Length());
-    for (int i = 0; i < intersect.Length(); ++i) {
-        res.arr_[i] = intersect.arr_[i] +
-                      std::max(0, other_second_rem.arr_[i] - second_rem.arr_[i]) +
-                      first_rem.arr_[i];
-        res.power_ += res.arr_[i];
+uint64_t Multiset::Power() const {
+    return power_;
+}
+
+uint64_t Multiset::Hash() const {
+    // FNV-1a over the places, the padding is left out so that the width does not matter
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < length_; ++i) {
+        hash = (hash ^ static_cast<uint32_t>(arr_[i])) * 0x100000001b3;
     }
-    return res;
+    return hash;
 }
-Multiset::Multiset(std::vector<int> arr) : arr_(std::move(arr)) {
-    power_ = 0;
-    for (int x : arr_) {
-        power_ += x;
+
+uint64_t Multiset::SupportMask() const {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < length_; ++i) {
+        if (arr_[i] != 0) {
+            mask |= uint64_t{1} << (i % 64);
+        }
     }
+    return mask;
 }
+
+Multiset Multiset::ReduceChild(const Multiset& intersect, const Multiset& other_second_rem,
+                               const Multiset& second_rem, const Multiset& first_rem) {
+    Multiset res = SameStorage(intersect);
+    res.power_ = MultisetKernels::Get().reduce_child(intersect.arr_, other_second_rem.arr_,
+                                                     second_rem.arr_, first_rem.arr_, res.arr_,
+                                                     res.width_);
+    return res;
+}
+
 std::string Multiset::ToString() const {
     std::stringstream builder;
     builder << '[';
-    for (int i = 0; i < arr_.size(); ++i) {
+    for (size_t i = 0; i < length_; ++i) {
         builder << arr_[i];
-        if (i != arr_.size() - 1) {
+        if (i != length_ - 1) {
             builder << ", ";
         }
     }
     builder << ']';
     return builder.str();
 }
+
 Multiset Multiset::Difference(const Multiset& other) const {
-    auto res = Multiset(arr_.size());
-    for (int i = 0; i < arr_.size(); ++i) {
+    Multiset res = SameStorage(*this);
+    for (size_t i = 0; i < length_; ++i) {
         res.arr_[i] = arr_[i] - other.arr_[i];
     }
     return res;
@@ -103,26 +284,132 @@ Transition::Transition(std::string id, std::string label, Multiset before, Multi
       after(std::move(after)) {
 }
 std::string Transition::ToString() const {
+    // Built in place rather than with Difference, which would take a row from the arena of the
+    // net while other threads may be writing trees of the same net
     std::stringstream builder;
-    builder << id << ", " << label << ", " << after.Difference(before).ToString();
+    builder << id << ", " << label << ", [";
+    for (size_t i = 0; i < after.Length(); ++i) {
+        builder << after.Data()[i] - before.Data()[i];
+        if (i != after.Length() - 1) {
+            builder << ", ";
+        }
+    }
+    builder << ']';
     return builder.str();
 }
 
 PetriNet::PetriNet(
     const std::vector<std::tuple<std::string, std::string, std::vector<int>, std::vector<int>>>&
-        trans_list) {
+        trans_list,
+    size_t place_num)
+    : place_num_(place_num), matrix_arena_(place_num_) {
     for (auto&& trans : trans_list) {
-        Multiset before(std::get<2>(trans));
-        Multiset after(std::get<3>(trans));
-        place_num_ = before.Length();
-        transitions.push_back(
-            std::make_unique<Transition>(std::get<0>(trans), std::get<1>(trans), before, after));
+        if (std::get<2>(trans).size() != place_num_ || std::get<3>(trans).size() != place_num_) {
+            throw std::invalid_argument("Transition " + std::get<0>(trans) +
+                                        " does not have a value for each of the " +
+                                        std::to_string(place_num_) + " places");
+        }
     }
-    for (auto&& trans : transitions) {
-        label_map[trans->label].push_back(trans.get());
+    // All before rows first, then all after rows, so that each matrix is contiguous in the arena
+    std::vector<Multiset> before_rows, after_rows;
+    for (auto&& trans : trans_list) {
+        before_rows.emplace_back(Multiset(std::get<2>(trans)), &matrix_arena_);
     }
+    for (auto&& trans : trans_list) {
+        after_rows.emplace_back(Multiset(std::get<3>(trans)), &matrix_arena_);
+    }
+    std::unordered_map<std::string, int> label_ids;
+    std::vector<std::vector<const Transition*>> by_label;
+    transitions_.reserve(trans_list.size());
+    for (size_t i = 0; i < trans_list.size(); ++i) {
+        transitions_.emplace_back(std::get<0>(trans_list[i]), std::get<1>(trans_list[i]),
+                                  std::move(before_rows[i]), std::move(after_rows[i]));
+        Transition& trans = transitions_.back();
+        trans.index = i;
+        auto label = label_ids.emplace(trans.label, static_cast<int>(label_ids.size())).first;
+        trans.label_id = label->second;
+        if (by_label.size() <= static_cast<size_t>(trans.label_id)) {
+            by_label.emplace_back();
+        }
+        by_label[trans.label_id].push_back(&trans);
+    }
+
+    // Supports are collected as offsets first, the array does not move afterwards
+    const std::vector<int>* rows[] = {nullptr, nullptr};
+    std::vector<size_t> offsets{0};
+    for (auto&& trans : trans_list) {
+        rows[0] = &std::get<2>(trans);
+        rows[1] = &std::get<3>(trans);
+        for (auto row : rows) {
+            for (size_t place = 0; place < row->size(); ++place) {
+                if ((*row)[place] != 0) {
+                    supports_.push_back(static_cast<uint32_t>(place));
+                }
+            }
+            offsets.push_back(supports_.size());
+        }
+    }
+    for (auto&& trans : transitions_) {
+        size_t i = 2 * trans.index;
+        trans.before_support = {supports_.data() + offsets[i], offsets[i + 1] - offsets[i]};
+        trans.after_support = {supports_.data() + offsets[i + 1], offsets[i + 2] - offsets[i + 1]};
+    }
+
+    label_offsets_.push_back(0);
+    for (auto&& candidates : by_label) {
+        candidates_.insert(candidates_.end(), candidates.begin(), candidates.end());
+        label_offsets_.push_back(candidates_.size());
+    }
+}
+
+const std::vector<Transition>& PetriNet::GetTransitions() const {
+    return transitions_;
+}
+
+Span<const Transition*> PetriNet::GetCandidates(int label_id) const {
+    return {candidates_.data() + label_offsets_[label_id],
+            label_offsets_[label_id + 1] - label_offsets_[label_id]};
 }
 
 size_t PetriNet::GetPlaceNum() const {
     return place_num_;
 }
+
+bool PetriNet::SameTransitions(const PetriNet& other) const {
+    if (place_num_ != other.place_num_ || transitions_.size() != other.transitions_.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < transitions_.size(); ++i) {
+        const Transition& left = transitions_[i];
+        const Transition& right = other.transitions_[i];
+        if (left.id != right.id || left.label != right.label || !(left.before == right.before) ||
+            !(left.after == right.after)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t PetriNet::Fingerprint() const {
+    // FNV-1a over the bytes of every field, stable across platforms and runs
+    uint64_t hash = 0xcbf29ce484222325;
+    auto mix = [&](const void* data, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ static_cast<const unsigned char*>(data)[i]) * 0x100000001b3;
+        }
+    };
+    auto place_num = static_cast<uint64_t>(place_num_);
+    mix(&place_num, sizeof(place_num));
+    for (auto&& trans : transitions_) {
+        auto length = static_cast<uint64_t>(trans.label.size());
+        mix(&length, sizeof(length));
+        mix(trans.label.data(), trans.label.size());
+        for (const Multiset* row : {&trans.before, &trans.after}) {
+            for (size_t place = 0; place < place_num_; ++place) {
+                auto value = static_cast<int32_t>(row->Data()[place]);
+                mix(&value, sizeof(value));
+            }
+        }
+    }
+    return hash;
+}
@@ -2,24 +2,139 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <unordered_map>
+#include <algorithm>
+#include "kernels.h"
 
 class Transition;
 
+/**
+ * Read-only view of a contiguous array
+ */
+template <class T>
+struct Span {
+    const T* data = nullptr;
+    size_t size = 0;
+
+    [[nodiscard]] const T* begin() const {
+        return data;
+    }
+
+    [[nodiscard]] const T* end() const {
+        return data + size;
+    }
+
+    const T& operator[](size_t i) const {
+        return data[i];
+    }
+};
+
+/**
+ * Slab allocator of fixed-width marking rows, shared by all multisets of a proof tree
+ */
+class MarkingArena {
+public:
+    explicit MarkingArena(size_t place_num);
+
+    MarkingArena(const MarkingArena&) = delete;
+    MarkingArena& operator=(const MarkingArena&) = delete;
+
+    /**
+     * Hands out a zeroed row, reusing released rows first
+     * @return pointer to the row of Width() elements
+     */
+    int* Allocate();
+
+    /**
+     * Returns a row to the arena for reuse
+     * @param row row previously obtained from Allocate
+     */
+    void Release(int* row);
+
+    /**
+     * Guards the arena with a mutex, for trees expanded by several threads
+     */
+    void SetConcurrent(bool concurrent);
+
+    [[nodiscard]] size_t Length() const;
+
+    [[nodiscard]] size_t Width() const;
+
+    /**
+     * @return bytes taken by the slabs of the arena
+     */
+    [[nodiscard]] size_t AllocatedBytes() const;
+
+private:
+    static constexpr size_t kRowsPerSlab = 1024;
+
+    bool concurrent_ = false;
+    std::mutex mutex_;
+    size_t place_num_, width_;
+    size_t slab_used_ = kRowsPerSlab;
+    std::atomic<size_t> slab_num_{0};
+    std::vector<std::unique_ptr<int[]>> slabs_;
+    std::vector<int*> free_rows_;
+};
+
 /**
  * Multiset of markings on the petri net
- * @tparam Num Number type to count for smaller net optimization
+ *
+ * Rows are padded with zeros up to the width given by RowWidth, so that nets with up to 8, 16
+ * or 32 places run the kernels with a compile-time trip count.
  */
 class Multiset {
 public:
+    /**
+     * Creates an empty multiset without a row, to be assigned later
+     */
+    Multiset() = default;
+
     explicit Multiset(size_t place_num);
 
     explicit Multiset(std::vector<int> arr);
 
+    /**
+     * Creates a zero multiset stored in the arena
+     * @param arena arena to take the row from
+     */
+    explicit Multiset(MarkingArena* arena);
+
+    /**
+     * Copies a multiset into the arena
+     * @param other multiset to copy
+     * @param arena arena to take the row from
+     * @throws std::invalid_argument if the arena holds rows of another number of places
+     */
+    Multiset(const Multiset& other, MarkingArena* arena);
+
+    Multiset(const Multiset& other);
+
+    Multiset(Multiset&& other) noexcept;
+
+    /**
+     * Copies the marking into the row of this multiset, which keeps its storage
+     * @throws std::invalid_argument if the multisets have different numbers of places
+     */
+    Multiset& operator=(const Multiset& other);
+
+    Multiset& operator=(Multiset&& other) noexcept;
+
+    ~Multiset();
+
     bool operator==(const Multiset& other) const;
 
+    /**
+     * @return the marking of every place, followed by the zero padding
+     */
+    [[nodiscard]] inline const int* Data() const {
+        return arr_;
+    }
+
     [[nodiscard]] Multiset Difference(const Multiset& other) const;
 
     static Multiset ReduceChild(const Multiset& intersect, const Multiset& other_second_rem,
@@ -30,7 +145,7 @@ public:
      */
     inline void Reset() {
         power_ = 0;
-        std::fill(arr_.begin(), arr_.end(), 0);
+        std::fill(arr_, arr_ + width_, 0);
     }
 
     /**
@@ -42,16 +157,12 @@ public:
         if (power_ > set.power_) {
             return false;
         }
-        for (int i = 0; i < Length(); ++i) {
-            if (arr_[i] > set.arr_[i]) {
-                return false;
-            }
-        }
-        return true;
+        return MultisetKernels::Get().subset_of(arr_, set.arr_, width_);
     }
 
     /**
-     * Constructs the new state using the weak transition property
+     * Constructs the new state using the weak transition property, touching only the places in
+     * the supports of delta
      * @param init initial vector of the transition
      * @param delta transition to execute
      * @return resulting multiset
@@ -59,7 +170,8 @@ public:
     static Multiset WeakTransition(const Multiset* init, const Transition* delta);
 
     /**
-     * Mirrors a weak transition done us
+     * Mirrors a weak transition done us, touching only the places in the before support of delta
+     * and the supports of gamma
      * @param init initial state
      * @param prev state on which delta_used fired
      * @param delta transition that we are mirroring
@@ -75,10 +187,40 @@ public:
 
     [[nodiscard]] size_t Length() const;
 
+    [[nodiscard]] uint64_t Power() const;
+
+    /**
+     * Computes a bitmask of the places holding tokens, folded modulo 64
+     * @return bitmask of the support of the multiset
+     */
+    [[nodiscard]] uint64_t SupportMask() const;
+
+    /**
+     * Computes a hash of the marking, equal for equal multisets
+     * @return hash of the multiset
+     */
+    [[nodiscard]] uint64_t Hash() const;
+
     [[nodiscard]] std::string ToString() const;
 
+    /**
+     * Creates a zero multiset with the same length and storage as a given one
+     */
+    static Multiset SameStorage(const Multiset& other);
+
+    /**
+     * Computes the padded row width for a number of places
+     * @param place_num number of places in the net
+     * @return 8, 16 or 32 for small nets, the next multiple of 8 otherwise
+     */
+    static size_t RowWidth(size_t place_num);
+
 private:
-    std::vector<int> arr_;
+    Multiset(MarkingArena* arena, size_t place_num);
+
+    int* arr_ = nullptr;
+    MarkingArena* arena_ = nullptr;  // nullptr if the row is owned by the multiset itself
+    uint32_t length_ = 0, width_ = 0;
     uint64_t power_ = 0;
 };
 
@@ -89,21 +231,65 @@ struct Transition {
     Transition(std::string id, std::string label, Multiset before, Multiset after);
     std::string label, id;
     Multiset before, after;
+    size_t index = 0;  // position in PetriNet::GetTransitions
+    int label_id = 0;  // dense id of the label
+    // Places where before and after are nonzero, in ascending order
+    Span<uint32_t> before_support, after_support;
 
     [[nodiscard]] std::string ToString() const;
 };
 
+/**
+ * Petri net compiled for the search
+ *
+ * Transitions are stored contiguously. Their before and after rows form two matrices in an arena
+ * of the net, and their supports share one array. Labels get dense ids, and the transitions with
+ * the same label form a contiguous range of candidates in the order of the net.
+ */
 class PetriNet {
 public:
-    explicit PetriNet(
+    /**
+     * Compiles the net
+     * @param trans_list (id, label, before, after) of every transition
+     * @param place_num number of places, the length of every before and after row
+     * @throws std::invalid_argument if a row of some transition has another length
+     */
+    PetriNet(
         const std::vector<std::tuple<std::string, std::string, std::vector<int>, std::vector<int>>>&
-            trans_list);
+            trans_list,
+        size_t place_num);
 
-    std::unordered_map<std::string, std::vector<Transition*>> label_map;
-    std::vector<std::unique_ptr<Transition>> transitions;
+    PetriNet(const PetriNet&) = delete;
+    PetriNet& operator=(const PetriNet&) = delete;
+
+    [[nodiscard]] const std::vector<Transition>& GetTransitions() const;
+
+    /**
+     * Finds the transitions that can mirror a transition with the given label
+     * @param label_id id of the label
+     * @return transitions with the label, in the order of the net
+     */
+    [[nodiscard]] Span<const Transition*> GetCandidates(int label_id) const;
 
     [[nodiscard]] size_t GetPlaceNum() const;
 
+    /**
+     * @return true if the other net has the same transitions in the same order
+     */
+    [[nodiscard]] bool SameTransitions(const PetriNet& other) const;
+
+    /**
+     * Hashes the number of places and the labels and rows of the transitions in their order.
+     * Transition ids are left out, as no proof depends on them.
+     * @return hash equal for nets that admit the same proofs
+     */
+    [[nodiscard]] uint64_t Fingerprint() const;
+
 private:
     size_t place_num_ = 0;
+    MarkingArena matrix_arena_;  // declared before the transitions, as it holds their rows
+    std::vector<Transition> transitions_;
+    std::vector<uint32_t> supports_;
+    std::vector<const Transition*> candidates_;
+    std::vector<size_t> label_offsets_;  // candidates of label i are [offsets[i], offsets[i + 1])
 };
@@ -0,0 +1,503 @@
+#include "pnml.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+constexpr size_t kChunkSize = size_t{1} << 16;
+
+/**
+ * Pull parser for the subset of XML found in PNML files
+ *
+ * The file is read in chunks. Declarations, processing instructions, comments and the doctype
+ * are skipped, character references and the predefined entities are decoded.
+ */
+class XmlReader {
+public:
+    enum class Event { kStart, kEnd, kText, kEof };
+
+    explicit XmlReader(const std::string& path)
+        : file_(std::fopen(path.c_str(), "rb"), &std::fclose), path_(path) {
+        if (file_ == nullptr) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+    }
+
+    /**
+     * Reads the next event. An empty element gives a start event followed by an end event.
+     * @return type of the event, its name, attributes and text are available until the next call
+     */
+    Event Next() {
+        if (pending_end_) {
+            pending_end_ = false;
+            return Event::kEnd;
+        }
+        while (true) {
+            int c = Peek();
+            if (c == EOF) {
+                return Event::kEof;
+            }
+            if (c != '<') {
+                text_.clear();
+                while ((c = Peek()) != EOF && c != '<') {
+                    ReadCharacter(&text_);
+                }
+                return Event::kText;
+            }
+            Get();
+            c = Peek();
+            if (c == '?') {
+                SkipPast("?>");
+            } else if (c == '!') {
+                Get();
+                if (Consume("--")) {
+                    SkipPast("-->");
+                } else if (Consume("[CDATA[")) {
+                    text_.clear();
+                    ReadUntil("]]>", &text_);
+                    return Event::kText;
+                } else {
+                    SkipDoctype();
+                }
+            } else if (c == '/') {
+                Get();
+                ReadName(&name_);
+                SkipSpace();
+                Expect('>');
+                return Event::kEnd;
+            } else {
+                ReadStartTag();
+                return Event::kStart;
+            }
+        }
+    }
+
+    [[nodiscard]] const std::string& Name() const {
+        return name_;
+    }
+
+    [[nodiscard]] const std::string& Text() const {
+        return text_;
+    }
+
+    /**
+     * @return value of the attribute of the last start tag, nullptr if it has none
+     */
+    [[nodiscard]] const std::string* Attribute(const std::string& name) const {
+        for (auto&& [key, value] : attributes_) {
+            if (key == name) {
+                return &value;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    int Peek() {
+        if (position_ == buffer_.size()) {
+            buffer_.resize(kChunkSize);
+            buffer_.resize(std::fread(buffer_.data(), 1, kChunkSize, file_.get()));
+            position_ = 0;
+            if (buffer_.empty()) {
+                return EOF;
+            }
+        }
+        return static_cast<unsigned char>(buffer_[position_]);
+    }
+
+    int Get() {
+        int c = Peek();
+        if (c != EOF) {
+            ++position_;
+            if (c == '\n') {
+                ++line_;
+            }
+        }
+        return c;
+    }
+
+    [[noreturn]] void Fail(const std::string& message) const {
+        throw std::runtime_error(path_ + ":" + std::to_string(line_) + ": " + message);
+    }
+
+    void Expect(char expected) {
+        if (Get() != expected) {
+            Fail(std::string("expected '") + expected + "'");
+        }
+    }
+
+    /**
+     * Consumes the text if the input continues with it. Only called with prefixes that cannot
+     * partially match, so nothing has to be given back.
+     */
+    bool Consume(const char* text) {
+        if (Peek() != static_cast<unsigned char>(*text)) {
+            return false;
+        }
+        for (; *text != '\0'; ++text) {
+            if (Get() != static_cast<unsigned char>(*text)) {
+                Fail("malformed markup");
+            }
+        }
+        return true;
+    }
+
+    void ReadUntil(const std::string& terminator, std::string* out) {
+        size_t matched = 0;
+        while (matched < terminator.size()) {
+            int c = Get();
+            if (c == EOF) {
+                Fail("unexpected end of file, expected '" + terminator + "'");
+            }
+            out->push_back(static_cast<char>(c));
+            if (c == terminator[matched]) {
+                ++matched;
+            } else {
+                matched = c == terminator[0] ? 1 : 0;
+            }
+        }
+        out->resize(out->size() - terminator.size());
+    }
+
+    void SkipPast(const std::string& terminator) {
+        skipped_.clear();
+        ReadUntil(terminator, &skipped_);
+    }
+
+    void SkipDoctype() {
+        int depth = 0;
+        while (true) {
+            int c = Get();
+            if (c == EOF) {
+                Fail("unexpected end of file in a declaration");
+            }
+            if (c == '[') {
+                ++depth;
+            } else if (c == ']') {
+                --depth;
+            } else if (c == '>' && depth <= 0) {
+                return;
+            }
+        }
+    }
+
+    static bool IsSpace(int c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    void SkipSpace() {
+        while (IsSpace(Peek())) {
+            Get();
+        }
+    }
+
+    void ReadName(std::string* out) {
+        out->clear();
+        int c;
+        while ((c = Peek()) != EOF && !IsSpace(c) && c != '>' && c != '/' && c != '=') {
+            out->push_back(static_cast<char>(Get()));
+        }
+        if (out->empty()) {
+            Fail("expected a name");
+        }
+    }
+
+    void ReadStartTag() {
+        ReadName(&name_);
+        attributes_.clear();
+        while (true) {
+            SkipSpace();
+            int c = Peek();
+            if (c == '>') {
+                Get();
+                return;
+            }
+            if (c == '/') {
+                Get();
+                Expect('>');
+                pending_end_ = true;
+                return;
+            }
+            std::string key, value;
+            ReadName(&key);
+            SkipSpace();
+            Expect('=');
+            SkipSpace();
+            int quote = Get();
+            if (quote != '"' && quote != '\'') {
+                Fail("expected a quoted attribute value");
+            }
+            while ((c = Peek()) != quote) {
+                if (c == EOF) {
+                    Fail("unexpected end of file in an attribute");
+                }
+                ReadCharacter(&value);
+            }
+            Get();
+            attributes_.emplace_back(std::move(key), std::move(value));
+        }
+    }
+
+    /**
+     * Reads one character of text, decoding a reference
+     */
+    void ReadCharacter(std::string* out) {
+        int c = Get();
+        if (c != '&') {
+            out->push_back(static_cast<char>(c));
+            return;
+        }
+        std::string entity;
+        while ((c = Get()) != ';') {
+            if (c == EOF || entity.size() > 10) {
+                Fail("malformed entity reference");
+            }
+            entity.push_back(static_cast<char>(c));
+        }
+        if (entity == "lt") {
+            out->push_back('<');
+        } else if (entity == "gt") {
+            out->push_back('>');
+        } else if (entity == "amp") {
+            out->push_back('&');
+        } else if (entity == "quot") {
+            out->push_back('"');
+        } else if (entity == "apos") {
+            out->push_back('\'');
+        } else if (entity.size() > 1 && entity[0] == '#') {
+            bool hex = entity[1] == 'x';
+            unsigned long code;
+            try {
+                code = std::stoul(entity.substr(hex ? 2 : 1), nullptr, hex ? 16 : 10);
+            } catch (const std::exception&) {
+                Fail("malformed character reference &" + entity + ";");
+            }
+            AppendUtf8(static_cast<uint32_t>(code), out);
+        } else {
+            Fail("unknown entity &" + entity + ";");
+        }
+    }
+
+    static void AppendUtf8(uint32_t code, std::string* out) {
+        if (code < 0x80) {
+            out->push_back(static_cast<char>(code));
+        } else if (code < 0x800) {
+            out->push_back(static_cast<char>(0xC0 | (code >> 6)));
+            out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        } else if (code < 0x10000) {
+            out->push_back(static_cast<char>(0xE0 | (code >> 12)));
+            out->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        } else {
+            out->push_back(static_cast<char>(0xF0 | (code >> 18)));
+            out->push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+            out->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+    }
+
+    std::unique_ptr<FILE, int (*)(FILE*)> file_;
+    std::string path_;
+    std::string buffer_;
+    size_t position_ = 0;
+    size_t line_ = 1;
+    bool pending_end_ = false;
+    std::string name_, text_, skipped_;
+    std::vector<std::pair<std::string, std::string>> attributes_;
+};
+
+std::string RequireAttribute(const XmlReader& reader, const std::string& element,
+                             const std::string& name) {
+    const std::string* value = reader.Attribute(name);
+    if (value == nullptr) {
+        throw std::runtime_error("A " + element + " has no " + name + " attribute");
+    }
+    return *value;
+}
+
+/**
+ * Splits a CSV line into fields, undoing the quoting of the csv module
+ */
+std::vector<std::string> SplitCsv(const std::string& line) {
+    std::vector<std::string> fields(1);
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+        char c = line[i];
+        if (quoted) {
+            if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+                fields.back().push_back('"');
+                ++i;
+            } else if (c == '"') {
+                quoted = false;
+            } else {
+                fields.back().push_back(c);
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields.emplace_back();
+        } else if (c != '\r') {
+            fields.back().push_back(c);
+        }
+    }
+    return fields;
+}
+
+}  // namespace
+
+PnmlNet ReadPnml(const std::string& path) {
+    struct Arc {
+        std::string source, target;
+    };
+    PnmlNet net;
+    std::unordered_map<std::string, size_t> place_map, transition_map;
+    std::vector<Arc> arcs;
+
+    XmlReader reader(path);
+    std::vector<std::string> stack;
+    // Position of the transition, of its name and of the text of the name being read
+    size_t transition_depth = 0, name_depth = 0, text_depth = 0;
+    bool label_read = false;
+    while (true) {
+        auto event = reader.Next();
+        if (event == XmlReader::Event::kEof) {
+            break;
+        }
+        if (event == XmlReader::Event::kStart) {
+            const std::string& name = reader.Name();
+            stack.push_back(name);
+            size_t depth = stack.size();
+            if (name == "place") {
+                auto id = RequireAttribute(reader, name, "id");
+                if (!place_map.emplace(id, net.places.size()).second) {
+                    throw std::runtime_error("Duplicate place ids in the parsing net");
+                }
+                net.places.push_back(std::move(id));
+            } else if (name == "transition") {
+                auto id = RequireAttribute(reader, name, "id");
+                if (!transition_map.emplace(id, net.transitions.size()).second) {
+                    throw std::runtime_error("Duplicate transition ids in the parsing net");
+                }
+                // Default name is transition's id
+                net.transitions.emplace_back(id, id, std::vector<int>(), std::vector<int>());
+                transition_depth = depth;
+            } else if (name == "arc") {
+                arcs.push_back(
+                    {RequireAttribute(reader, name, "source"), RequireAttribute(reader, name, "target")});
+            } else if (name == "name" && transition_depth != 0 && depth == transition_depth + 1) {
+                name_depth = depth;
+                label_read = false;
+            } else if (name == "text" && name_depth != 0 && text_depth == 0 && !label_read) {
+                text_depth = depth;
+                std::get<1>(net.transitions.back()).clear();
+            }
+        } else if (event == XmlReader::Event::kText) {
+            // Only the first text of the label counts, like firstChild in minidom
+            if (text_depth != 0 && text_depth == stack.size() && !label_read) {
+                std::get<1>(net.transitions.back()) = reader.Text();
+                label_read = true;
+            }
+        } else {
+            if (stack.empty() || stack.back() != reader.Name()) {
+                throw std::runtime_error(path + " is not well-formed: unexpected </" +
+                                         reader.Name() + ">");
+            }
+            size_t depth = stack.size();
+            stack.pop_back();
+            if (depth == text_depth) {
+                text_depth = 0;
+                label_read = true;
+            } else if (depth == name_depth) {
+                name_depth = 0;
+            } else if (depth == transition_depth) {
+                transition_depth = 0;
+            }
+        }
+    }
+    if (!stack.empty()) {
+        throw std::runtime_error(path + " is not well-formed: <" + stack.back() + "> is not closed");
+    }
+
+    // Arcs may come before the nodes they join, so they are resolved at the end
+    size_t place_num = net.places.size();
+    for (auto&& transition : net.transitions) {
+        std::get<2>(transition).assign(place_num, 0);
+        std::get<3>(transition).assign(place_num, 0);
+    }
+    for (auto&& arc : arcs) {
+        auto source_place = place_map.find(arc.source);
+        auto target_place = place_map.find(arc.target);
+        auto source_transition = transition_map.find(arc.source);
+        auto target_transition = transition_map.find(arc.target);
+        if (source_place != place_map.end() && target_transition != transition_map.end()) {
+            std::get<2>(net.transitions[target_transition->second])[source_place->second] += 1;
+        } else if (target_place != place_map.end() &&
+                   source_transition != transition_map.end()) {
+            std::get<3>(net.transitions[source_transition->second])[target_place->second] += 1;
+        } else {
+            throw std::runtime_error("Invalid arc source and/or target");
+        }
+    }
+    return net;
+}
+
+std::pair<std::vector<int>, std::vector<int>> ReadResources(
+    const std::string& path, const std::vector<std::string>& places) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    std::vector<std::vector<std::string>> rows;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line != "\r") {
+            rows.push_back(SplitCsv(line));
+        }
+    }
+    // Validating table params
+    if (rows.size() != 3) {
+        throw std::runtime_error("Invalid number of rows in the file");
+    }
+    std::unordered_map<std::string, size_t> place_map;
+    for (size_t i = 0; i < places.size(); ++i) {
+        place_map.emplace(places[i], i);
+    }
+    std::pair<std::vector<int>, std::vector<int>> resources{std::vector<int>(places.size()),
+                                                            std::vector<int>(places.size())};
+    std::vector<bool> seen(places.size(), false);
+    size_t columns = std::min({rows[0].size(), rows[1].size(), rows[2].size()});
+    for (size_t column = 0; column < columns; ++column) {
+        auto place = place_map.find(rows[0][column]);
+        if (place == place_map.end()) {
+            throw std::runtime_error("Place ids do not match the ones in Petri net");
+        }
+        if (seen[place->second]) {
+            throw std::runtime_error("Table contains duplicate place ids");
+        }
+        seen[place->second] = true;
+        for (int row = 1; row <= 2; ++row) {
+            const std::string& value = rows[row][column];
+            if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+                throw std::runtime_error("Table body must only contain non-negative integers");
+            }
+            int count;
+            try {
+                count = std::stoi(value);
+            } catch (const std::out_of_range&) {
+                throw std::runtime_error("Resource value " + value + " is too large");
+            }
+            (row == 1 ? resources.first : resources.second)[place->second] = count;
+        }
+    }
+    for (bool present : seen) {
+        if (!present) {
+            throw std::runtime_error("Place ids do not match the ones in Petri net");
+        }
+    }
+    return resources;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+#include <tuple>
+#include <vector>
+
+/**
+ * Petri net read from a PNML file, in the form taken by the PetriNet constructor
+ */
+struct PnmlNet {
+    std::vector<std::string> places;  // place ids by index
+    // (id, label, before, after) of every transition, in the order of the file
+    std::vector<std::tuple<std::string, std::string, std::vector<int>, std::vector<int>>>
+        transitions;
+};
+
+/**
+ * Reads a .pnml file in a single streaming pass, with the rules of ui/qtui/io/petri.py:
+ * places are numbered in the order of the file, the label of a transition is the first text of
+ * its name, its id if it has none, and every arc adds one token to its side of the transition
+ * @param path path to the file
+ * @return places and transitions of the net
+ * @throws std::runtime_error if the file cannot be read, is not well-formed, repeats an id or
+ * has an arc that does not join a place and a transition
+ */
+PnmlNet ReadPnml(const std::string& path);
+
+/**
+ * Reads a pair of resources from a .csv file with the place ids in its first row and the two
+ * resources in the next ones, as written by the UI
+ * @param path path to the file
+ * @param places place ids of the net by index
+ * @return the two resources ordered by place index
+ * @throws std::runtime_error if the file cannot be read or does not match the places
+ */
+std::pair<std::vector<int>, std::vector<int>> ReadResources(const std::string& path,
+                                                            const std::vector<std::string>& places);
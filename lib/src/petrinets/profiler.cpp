@@ -0,0 +1,189 @@
+#include "profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include "outputstream.h"
+
+namespace {
+
+/**
+ * Writes text as a JSON string
+ */
+void WriteJsonString(OutputStream* output, std::string_view text) {
+    output->Write('"');
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            output->Write('\\');
+            output->Write(c);
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            output->Write(escaped);
+        } else {
+            output->Write(c);
+        }
+    }
+    output->Write('"');
+}
+
+/**
+ * Writes a number of microseconds with a fractional part, as the trace expects
+ */
+void WriteMicroseconds(OutputStream* output, std::chrono::steady_clock::duration time) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.3f",
+                  std::chrono::duration<double, std::micro>(time).count());
+    output->Write(text);
+}
+
+void WriteSeconds(OutputStream* output, double seconds) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.9g", seconds);
+    output->Write(text);
+}
+
+}  // namespace
+
+const char* PhaseName(SearchPhase phase) {
+    switch (phase) {
+        case SearchPhase::kGenerate:
+            return "generate";
+        case SearchPhase::kReduce:
+            return "reduce";
+        case SearchPhase::kMemo:
+            return "memo";
+        case SearchPhase::kComplete:
+            return "complete";
+        default:
+            return "";
+    }
+}
+
+SearchProfiler::SearchProfiler(size_t transition_num, int trace_depth)
+    : trace_depth_(trace_depth),
+      transition_num_(transition_num),
+      transition_tried_(std::make_unique<Counter[]>(transition_num)),
+      transition_rejected_(std::make_unique<Counter[]>(transition_num)) {
+}
+
+void SearchProfiler::AddSpan(const TraceSpan& span) {
+    std::lock_guard<std::mutex> lock(spans_mutex_);
+    spans_.push_back(span);
+}
+
+int SearchProfiler::ThreadId() {
+    static std::atomic<int> next_id{0};
+    thread_local int id = next_id++;
+    return id;
+}
+
+SearchProfile SearchProfiler::Profile() const {
+    SearchProfile profile;
+    profile.expand_iterations = expand_iterations_;
+    profile.backtracks = backtracks_;
+    profile.max_backtracks = max_backtracks_;
+    profile.candidates_tried = candidates_tried_;
+    profile.candidates_rejected = candidates_rejected_;
+    profile.reduce_comparisons = reduce_comparisons_;
+    profile.reduce_hits = reduce_hits_;
+    profile.max_depth = static_cast<int>(max_depth_.load());
+    for (size_t i = 0; i < phase_ticks_.size(); ++i) {
+        profile.phase_seconds[i] = std::chrono::duration<double>(
+                                       std::chrono::steady_clock::duration(phase_ticks_[i]))
+                                       .count();
+    }
+    for (size_t i = 0; i < transition_num_; ++i) {
+        profile.transition_tried.push_back(transition_tried_[i]);
+        profile.transition_rejected.push_back(transition_rejected_[i]);
+    }
+    return profile;
+}
+
+void SearchProfiler::WriteTrace(const std::string& path,
+                                std::chrono::steady_clock::time_point start,
+                                const std::vector<std::string>& transitions) const {
+    auto output = OutputStream::Open(path);
+    output->Write("{\"traceEvents\":[");
+    std::vector<TraceSpan> spans;
+    {
+        std::lock_guard<std::mutex> lock(spans_mutex_);
+        spans = spans_;
+    }
+    // Viewers nest the spans of a thread by their order in the file
+    std::sort(spans.begin(), spans.end(), [](const TraceSpan& left, const TraceSpan& right) {
+        return left.start < right.start || (left.start == right.start && left.end > right.end);
+    });
+    bool first = true;
+    for (auto&& span : spans) {
+        if (!first) {
+            output->Write(',');
+        }
+        first = false;
+        std::string name = "root";
+        if (span.delta >= 0) {
+            name = transitions[span.delta] + (span.order > 0 ? " rs" : " sr");
+        }
+        output->Write("\n{\"name\":");
+        WriteJsonString(output.get(), name);
+        output->Write(",\"cat\":\"expand\",\"ph\":\"X\",\"pid\":1,\"tid\":");
+        output->WriteInt(span.thread);
+        output->Write(",\"ts\":");
+        WriteMicroseconds(output.get(), span.start - start);
+        output->Write(",\"dur\":");
+        WriteMicroseconds(output.get(), span.end - span.start);
+        output->Write(",\"args\":{\"depth\":");
+        output->WriteInt(span.depth);
+        output->Write(",\"nodes\":");
+        output->WriteInt(static_cast<int64_t>(span.nodes));
+        output->Write(",\"backtracks\":");
+        output->WriteInt(static_cast<int64_t>(span.backtracks));
+        output->Write(",\"proven\":");
+        output->Write(span.proven ? "true" : "false");
+        output->Write("}}");
+    }
+
+    SearchProfile profile = Profile();
+    output->Write("\n],\"displayTimeUnit\":\"ms\",\"otherData\":{");
+    auto write_counter = [&](const char* name, size_t value) {
+        WriteJsonString(output.get(), name);
+        output->Write(':');
+        output->WriteInt(static_cast<int64_t>(value));
+        output->Write(',');
+    };
+    write_counter("expand_iterations", profile.expand_iterations);
+    write_counter("backtracks", profile.backtracks);
+    write_counter("max_backtracks", profile.max_backtracks);
+    write_counter("candidates_tried", profile.candidates_tried);
+    write_counter("candidates_rejected", profile.candidates_rejected);
+    write_counter("reduce_comparisons", profile.reduce_comparisons);
+    write_counter("reduce_hits", profile.reduce_hits);
+    write_counter("max_depth", static_cast<size_t>(profile.max_depth));
+    for (size_t i = 0; i < profile.phase_seconds.size(); ++i) {
+        WriteJsonString(output.get(),
+                        std::string(PhaseName(static_cast<SearchPhase>(i))) + "_seconds");
+        output->Write(':');
+        WriteSeconds(output.get(), profile.phase_seconds[i]);
+        output->Write(',');
+    }
+    // Transitions whose candidates were tried, the most tried first
+    std::vector<size_t> order;
+    for (size_t i = 0; i < transition_num_; ++i) {
+        if (profile.transition_tried[i] > 0) {
+            order.push_back(i);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t left, size_t right) {
+        return profile.transition_tried[left] > profile.transition_tried[right];
+    });
+    output->Write("\"transitions\":[");
+    for (size_t i = 0; i < order.size(); ++i) {
+        output->Write(i == 0 ? "\n{\"transition\":" : ",\n{\"transition\":");
+        WriteJsonString(output.get(), transitions[order[i]]);
+        output->Write(",\"tried\":");
+        output->WriteInt(static_cast<int64_t>(profile.transition_tried[order[i]]));
+        output->Write(",\"rejected\":");
+        output->WriteInt(static_cast<int64_t>(profile.transition_rejected[order[i]]));
+        output->Write('}');
+    }
+    output->Write("]}}\n");
+    output->Close();
+}
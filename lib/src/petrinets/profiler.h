@@ -0,0 +1,179 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Parts of the search timed by the profiler
+ */
+enum class SearchPhase { kGenerate, kReduce, kMemo, kComplete, kCount };
+
+/**
+ * @return name of the phase as used in the stats and the trace
+ */
+const char* PhaseName(SearchPhase phase);
+
+/**
+ * Detailed counters of a profiled check. Phase times of parallel checks are summed over threads.
+ */
+struct SearchProfile {
+    size_t expand_iterations = 0;    // steps of the EXPAND loop
+    size_t backtracks = 0;           // failed children replaced by another gamma
+    size_t max_backtracks = 0;       // most backtracks of a single node
+    size_t candidates_tried = 0;     // gamma candidates passed to MirrorTransition
+    size_t candidates_rejected = 0;  // candidates MirrorTransition could not fire
+    size_t reduce_comparisons = 0;   // ancestors compared with a node by REDUCE
+    size_t reduce_hits = 0;          // REDUCE children created
+    int max_depth = 0;               // deepest EXPAND step
+    std::array<double, static_cast<size_t>(SearchPhase::kCount)> phase_seconds{};
+    // Candidates tried and rejected for each delta transition, by transition index
+    std::vector<size_t> transition_tried, transition_rejected;
+};
+
+/**
+ * Expanded subtree recorded for the trace
+ */
+struct TraceSpan {
+    std::chrono::steady_clock::time_point start, end;
+    int thread = 0;
+    int depth = 0;
+    // Transition and order of the delta child the subtree comes from, through REDUCE steps if
+    // any, -1 and 0 for the root
+    int delta = -1;
+    int order = 0;
+    size_t nodes = 0;  // nodes created while it was expanded, by any thread
+    size_t backtracks = 0;
+    bool proven = false;
+};
+
+/**
+ * Counters of the hot path of ProofTree, created only when a check is profiled so that the
+ * search pays a single branch otherwise. All counters are relaxed atomics shared by the threads.
+ */
+class SearchProfiler {
+public:
+    /**
+     * @param transition_num number of transitions of the net
+     * @param trace_depth subtrees expanded at a lower depth are recorded as trace spans
+     */
+    SearchProfiler(size_t transition_num, int trace_depth);
+
+    SearchProfiler(const SearchProfiler&) = delete;
+    SearchProfiler& operator=(const SearchProfiler&) = delete;
+
+    inline void AddExpandIteration() {
+        expand_iterations_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @param node_backtracks backtracks of the node so far, including this one
+     */
+    inline void AddBacktrack(size_t node_backtracks) {
+        backtracks_.fetch_add(1, std::memory_order_relaxed);
+        UpdateMax(&max_backtracks_, node_backtracks);
+    }
+
+    inline void AddCandidate(size_t delta, bool rejected) {
+        candidates_tried_.fetch_add(1, std::memory_order_relaxed);
+        transition_tried_[delta].fetch_add(1, std::memory_order_relaxed);
+        if (rejected) {
+            candidates_rejected_.fetch_add(1, std::memory_order_relaxed);
+            transition_rejected_[delta].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    inline void AddReduceComparison(bool hit) {
+        reduce_comparisons_.fetch_add(1, std::memory_order_relaxed);
+        if (hit) {
+            reduce_hits_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    inline void ReachDepth(int depth) {
+        UpdateMax(&max_depth_, static_cast<size_t>(depth));
+    }
+
+    inline void AddPhaseTime(SearchPhase phase, std::chrono::steady_clock::duration time) {
+        phase_ticks_[static_cast<size_t>(phase)].fetch_add(time.count(),
+                                                           std::memory_order_relaxed);
+    }
+
+    /**
+     * @return true if subtrees expanded at the depth are recorded
+     */
+    [[nodiscard]] inline bool Traced(int depth) const {
+        return depth < trace_depth_;
+    }
+
+    void AddSpan(const TraceSpan& span);
+
+    /**
+     * @return small id of the calling thread for the trace
+     */
+    static int ThreadId();
+
+    [[nodiscard]] SearchProfile Profile() const;
+
+    /**
+     * Writes the recorded spans in the Chrome trace event format, readable by chrome://tracing
+     * and Perfetto, with the counters of the profile in its metadata
+     * @param path path to the file, compressed with gzip or zstd if it ends with .gz or .zst
+     * @param start start of the check, the origin of the timestamps
+     * @param transitions names of the transitions by index
+     */
+    void WriteTrace(const std::string& path, std::chrono::steady_clock::time_point start,
+                    const std::vector<std::string>& transitions) const;
+
+private:
+    using Counter = std::atomic<size_t>;
+
+    static inline void UpdateMax(Counter* counter, size_t value) {
+        size_t current = counter->load(std::memory_order_relaxed);
+        while (value > current &&
+               !counter->compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    int trace_depth_;
+    size_t transition_num_;
+    Counter expand_iterations_{0}, backtracks_{0}, max_backtracks_{0};
+    Counter candidates_tried_{0}, candidates_rejected_{0};
+    Counter reduce_comparisons_{0}, reduce_hits_{0}, max_depth_{0};
+    using Ticks = std::atomic<std::chrono::steady_clock::rep>;
+    std::array<Ticks, static_cast<size_t>(SearchPhase::kCount)> phase_ticks_{};
+    std::unique_ptr<Counter[]> transition_tried_, transition_rejected_;
+    mutable std::mutex spans_mutex_;
+    std::vector<TraceSpan> spans_;
+};
+
+/**
+ * Adds the time of its scope to a phase of the profiler, if there is one
+ */
+class PhaseTimer {
+public:
+    inline PhaseTimer(SearchProfiler* profiler, SearchPhase phase)
+        : profiler_(profiler), phase_(phase) {
+        if (profiler_ != nullptr) {
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    inline ~PhaseTimer() {
+        if (profiler_ != nullptr) {
+            profiler_->AddPhaseTime(phase_, std::chrono::steady_clock::now() - start_);
+        }
+    }
+
+private:
+    SearchProfiler* profiler_;
+    SearchPhase phase_;
+    std::chrono::steady_clock::time_point start_;
+};
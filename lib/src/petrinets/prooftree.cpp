@@ -1,234 +1,1864 @@
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <queue>
+#include <stdexcept>
 #include "prooftree.h"
+#include "certificate.h"
+#include "graphml.h"
+#include "treefile.h"
 
-ProofTree::ProofTree(Multiset first, Multiset second, PetriNet* net, bool record_basis)
-    : petri_net_(net), record_basis_(record_basis) {
-    root_ = std::make_unique<Node>(std::move(first), std::move(second), petri_net_->transitions,
-                                   nullptr, nullptr, 0);
+namespace {
+
+// Children are forked onto the pool only this close to the root, where the subtrees are large
+// enough to pay for a task, which also bounds how deep the joining threads nest on their
+// native stacks
+constexpr int kMaxForkDepth = 8;
+
+/**
+ * Hashes a pair of markings independently of their order
+ */
+uint64_t PairHash(const Multiset& first, const Multiset& second) {
+    uint64_t first_hash = first.Hash(), second_hash = second.Hash();
+    return (std::min(first_hash, second_hash) * 0x9e3779b97f4a7c15) ^
+           std::max(first_hash, second_hash);
+}
+
+/**
+ * Sums the absolute differences of two rows over the places
+ */
+uint64_t Distance(const int* first, const int* second, size_t place_num) {
+    uint64_t distance = 0;
+    for (size_t i = 0; i < place_num; ++i) {
+        distance += static_cast<uint64_t>(std::abs(first[i] - second[i]));
+    }
+    return distance;
+}
+
+}  // namespace
+
+SharedMemo::SharedMemo(size_t place_num) : arena_(place_num) {
+}
+
+bool SharedMemo::Contains(const Multiset& first, const Multiset& second) const {
+    std::shared_lock lock(mutex_);
+    return ContainsLocked(first, second, PairHash(first, second));
+}
+
+void SharedMemo::Insert(const Multiset& first, const Multiset& second) {
+    uint64_t hash = PairHash(first, second);
+    std::unique_lock lock(mutex_);
+    if (ContainsLocked(first, second, hash)) {
+        return;
+    }
+    entries_.emplace(hash, std::make_pair(Multiset(first, &arena_), Multiset(second, &arena_)));
+}
+
+size_t SharedMemo::Size() const {
+    std::shared_lock lock(mutex_);
+    return entries_.size();
+}
+
+bool SharedMemo::ContainsLocked(const Multiset& first, const Multiset& second,
+                                uint64_t hash) const {
+    auto range = entries_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        const auto& [known_first, known_second] = it->second;
+        if ((known_first == first && known_second == second) ||
+            (known_first == second && known_second == first)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ProofTree::ProofTree(Multiset first, Multiset second, PetriNet* net, bool record_basis,
+                     size_t thread_num)
+    : arena_(net->GetPlaceNum()), memo_(&arena_),
+      refuted_(&arena_),
+      record_basis_(record_basis), petri_net_(net) {
+    if (thread_num > 1) {
+        arena_.SetConcurrent(true);
+        node_pool_.SetConcurrent(true);
+        memo_.SetConcurrent(true);
+        refuted_.SetConcurrent(true);
+        pool_ = std::make_unique<ThreadPool>(thread_num - 1);
+    }
+    root_ = MakeNode(Multiset(first, &arena_), Multiset(second, &arena_), nullptr, nullptr, 0);
+}
+
+ProofTree::~ProofTree() {
+    // The released nodes are not kept any more
+    certifiable_ = false;
+}
+
+void ProofTree::SetLimits(const SearchLimits& limits) {
+    limits_ = limits;
+}
+
+void ProofTree::SetStrategy(const SearchStrategy& strategy) {
+    strategy_ = strategy;
+    gamma_order_.clear();
+    gamma_offsets_.clear();
+    if (strategy.gamma_order == GammaOrder::kNet) {
+        return;
+    }
+    size_t place_num = petri_net_->GetPlaceNum();
+    for (auto&& delta : petri_net_->GetTransitions()) {
+        auto candidates = petri_net_->GetCandidates(delta.label_id);
+        std::vector<std::pair<uint64_t, const Transition*>> ranked;
+        for (const Transition* gamma : candidates) {
+            ranked.emplace_back(
+                Distance(delta.before.Data(), gamma->before.Data(), place_num) +
+                    Distance(delta.after.Data(), gamma->after.Data(), place_num),
+                gamma);
+        }
+        std::stable_sort(ranked.begin(), ranked.end(), [](auto&& left, auto&& right) {
+            return left.first < right.first;
+        });
+        gamma_offsets_.push_back(gamma_order_.size());
+        for (auto&& [distance, gamma] : ranked) {
+            gamma_order_.push_back(gamma);
+        }
+    }
+}
+
+void ProofTree::SetCancellation(const CancellationToken* token) {
+    cancellation_ = token;
+}
+
+void ProofTree::SetProgressCallback(std::function<void(const SearchProgress&)> callback,
+                                    double interval) {
+    progress_callback_ = std::move(callback);
+    progress_interval_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(interval));
+}
+
+void ProofTree::SetMemoization(bool enabled) {
+    memoize_ = enabled;
+}
+
+void ProofTree::SetSharedMemo(SharedMemo* shared) {
+    shared_memo_ = shared;
+}
+
+void ProofTree::SetCertifiable(bool enabled) {
+    certifiable_ = enabled;
+}
+
+void ProofTree::SetProfiling(bool enabled, int trace_depth) {
+    profiler_ = enabled ? std::make_unique<SearchProfiler>(petri_net_->GetTransitions().size(),
+                                                           trace_depth)
+                        : nullptr;
+}
+
+void ProofTree::Reuse(const ProofTree& previous) {
+    const PetriNet* old_net = previous.petri_net_;
+    if (old_net->GetPlaceNum() != petri_net_->GetPlaceNum()) {
+        return;
+    }
+    if (old_net == petri_net_ || old_net->SameTransitions(*petri_net_)) {
+        // Such verdicts depend on the net only, a certificate has no proof of the proven ones
+        reused_pairs_ = refuted_.Import(previous.refuted_);
+        if (!certifiable_) {
+            reused_pairs_ += memo_.ImportUnscoped(previous.memo_);
+        }
+    }
+
+    std::unordered_map<std::string, const Transition*> by_id;
+    for (auto&& transition : petri_net_->GetTransitions()) {
+        by_id.emplace(transition.id, &transition);
+    }
+    hints_ = std::make_unique<GammaHints>(petri_net_->GetPlaceNum());
+    std::vector<const Node*> stack{previous.root_.get()};
+    while (!stack.empty()) {
+        const Node* node = stack.back();
+        stack.pop_back();
+        std::vector<int> offsets;
+        for (auto&& child : node->children) {
+            stack.push_back(child.get());
+            if (child->order_used == 0) {
+                continue;
+            }
+            auto delta = by_id.find(child->delta_used->id);
+            auto gamma = by_id.find(child->gamma_used->id);
+            if (delta == by_id.end() || gamma == by_id.end() ||
+                delta->second->label_id != gamma->second->label_id) {
+                continue;
+            }
+            auto candidates = Candidates(delta->second);
+            auto position = std::find(candidates.begin(), candidates.end(), gamma->second);
+            if (offsets.empty()) {
+                offsets.assign(2 * petri_net_->GetTransitions().size(), 0);
+            }
+            offsets[2 * delta->second->index + (child->order_used > 0 ? 0 : 1)] =
+                static_cast<int>(position - candidates.begin());
+        }
+        if (!offsets.empty() && hints_->Find(node->first, node->second) == nullptr) {
+            hints_->Insert(node->first, node->second, std::move(offsets));
+        }
+    }
 }
 
-bool ProofTree::CheckBisimilarity() {
-    success = Expand(root_.get(), 0);
-    return success;
+void ProofTree::SetSpilling(const std::string& path) {
+    if (path.empty()) {
+        spill_.reset();
+        return;
+    }
+    if (record_basis_) {
+        throw std::invalid_argument("The basis compares every node of the tree, which spilling "
+                                    "evicts from memory");
+    }
+    spill_ = std::make_unique<SpillFile>(path, petri_net_->GetPlaceNum());
+}
+
+SearchStats ProofTree::Stats() const {
+    SearchStats stats;
+    stats.nodes_created = nodes_created_;
+    stats.memo_hits = memo_hits_;
+    stats.memo_misses = memo_misses_;
+    stats.refuted_hits = refuted_hits_;
+    stats.peak_memory = peak_memory_;
+    stats.seconds = std::chrono::duration<double>(elapsed_).count();
+    stats.reused_pairs = reused_pairs_;
+    stats.hinted_nodes = hinted_nodes_;
+    stats.spilled_nodes = spilled_nodes_;
+    stats.deepening_passes = deepening_passes_;
+    if (profiler_ != nullptr) {
+        stats.profiled = true;
+        stats.profile = profiler_->Profile();
+    }
+    return stats;
+}
+
+void ProofTree::WriteTrace(const std::string& path) const {
+    if (profiler_ == nullptr) {
+        throw std::logic_error("The check was not profiled");
+    }
+    std::vector<std::string> names;
+    for (auto&& transition : petri_net_->GetTransitions()) {
+        names.push_back(transition.id + " (" + transition.label + ")");
+    }
+    profiler_->WriteTrace(path, start_time_, names);
+}
+
+Verdict ProofTree::CheckBisimilarity() {
+    start_time_ = std::chrono::steady_clock::now();
+    limit_exceeded_ = false;
+    next_report_ = progress_interval_.count();
+    root_->ComputeKey();
+    SharedMemo* shared = memoize_ ? shared_memo_ : nullptr;
+    if (shared != nullptr && !certifiable_ && shared->Contains(root_->first, root_->second)) {
+        // Another check of the net already proved the pair
+        ++memo_hits_;
+        root_->memo = 1;
+        success = true;
+    } else if (pool_ != nullptr) {
+        CancellationToken token(cancellation_);
+        success = Search(&token);
+    } else {
+        success = Search(cancellation_);
+    }
+    if (limit_exceeded_ || (cancellation_ != nullptr && cancellation_->IsCancelled())) {
+        success = false;
+        verdict_ = Verdict::kUnknown;
+    } else {
+        verdict_ = success ? Verdict::kBisimilar : Verdict::kNotBisimilar;
+    }
+    if (verdict_ == Verdict::kBisimilar && shared != nullptr) {
+        shared->Insert(root_->first, root_->second);
+    }
+    elapsed_ = std::chrono::steady_clock::now() - start_time_;
+    return verdict_;
+}
+
+bool ProofTree::Search(const CancellationToken* token) {
+    deepening_passes_ = 0;
+    if (strategy_.deepening_step <= 0) {
+        return Expand(root_.get(), 0, token);
+    }
+    // Proofs found under a bound are proofs, and refutations not cut off by it are recorded as
+    // usual, so only the verdicts that assume no ancestor carry over to the next pass
+    for (depth_bound_ = strategy_.deepening_step;; depth_bound_ += strategy_.deepening_step) {
+        ++deepening_passes_;
+        bool proven = Expand(root_.get(), 0, token);
+        if (proven || !root_->cut_off || Interrupted(token)) {
+            depth_bound_ = 0;
+            return proven;
+        }
+        root_->Reset();
+    }
 }
 
-bool ProofTree::Expand(Node* node, int depth) {
+std::vector<uint32_t> ProofTree::VisitOrder(const Node* node) const {
+    std::vector<uint32_t> order;
+    if (strategy_.child_order == ChildOrder::kNet) {
+        return order;
+    }
+    size_t place_num = petri_net_->GetPlaceNum();
+    std::vector<uint64_t> distances;
+    for (auto&& child : node->children) {
+        order.push_back(static_cast<uint32_t>(order.size()));
+        distances.push_back(Distance(child->first.Data(), child->second.Data(), place_num));
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t left, uint32_t right) {
+        return distances[left] > distances[right];
+    });
+    return order;
+}
+
+Span<const Transition*> ProofTree::Candidates(const Transition* delta) const {
+    auto candidates = petri_net_->GetCandidates(delta->label_id);
+    if (gamma_offsets_.empty()) {
+        return candidates;
+    }
+    return {gamma_order_.data() + gamma_offsets_[delta->index], candidates.size};
+}
+
+bool ProofTree::Expand(Node* node, int depth, const CancellationToken* token) {
     if (node->first == node->second) {
         return true;
     }
+    if (!GenerateChildren(node, depth, token)) {
+        return false;
+    }
+    std::vector<ExpandFrame> stack;
+    PushFrame(&stack, node, depth);
+    bool proven = true;  // outcome of the last finished child
+    // Pops the finished top frame and completes its node under the next one
+    auto finish = [&](bool result) {
+        Node* done = stack.back().node;
+        PopFrame(&stack, result);
+        if (!stack.empty()) {
+            Node* top = Complete(done, stack.back().node, result, token);
+            stack.back().node->dependency =
+                std::min(stack.back().node->dependency, top->dependency);
+            stack.back().child_cut = stack.back().child_cut || (!result && top->cut_off);
+        }
+        proven = result;
+    };
+    while (!stack.empty()) {
+        if (profiler_ != nullptr) {
+            profiler_->AddExpandIteration();
+        }
+        ExpandFrame& frame = stack.back();
+        if (!proven) {
+            // Only the failed child is replaced, by the next gamma choice of its delta. The
+            // other delta children do not depend on that choice, so the proven ones are kept.
+            size_t failed = frame.next_child - 1;
+            size_t index = frame.order.empty() ? failed : frame.order[failed];
+            ++frame.backtracks;
+            if (profiler_ != nullptr) {
+                profiler_->AddBacktrack(frame.backtracks);
+            }
+            if (NextChoice(frame.node, index, token)) {
+                frame.next_child = failed;
+            } else if (frame.child_cut && !Interrupted(token)) {
+                // The child may still have a proof deeper down, while a later child may refute
+                // the node outright
+                frame.cut_skipped = true;
+                frame.child_cut = false;
+            } else {
+                frame.node->cut_off = false;
+                finish(false);
+                continue;
+            }
+            proven = true;
+        } else {
+            frame.child_cut = false;
+        }
+        // Forking pays off only if another thread would pick the siblings up at once
+        if (pool_ != nullptr && frame.next_child == 0 && frame.depth < kMaxForkDepth &&
+            frame.node->children.size() > 1 && pool_->HasIdleThread()) {
+            frame.next_child = frame.node->children.size();
+            frame.node->forked = true;
+            finish(ReduceChildren(frame.node, frame.depth, token));
+            continue;
+        }
+        if (frame.next_child == frame.node->children.size()) {
+            frame.node->cut_off = frame.cut_skipped;
+            finish(!frame.cut_skipped);
+            continue;
+        }
+        size_t position = frame.next_child++;
+        Node* child =
+            frame.node->children[frame.order.empty() ? position : frame.order[position]].get();
+        Node* leaf = Reduce(child);
+        bool settled = Settle(leaf, &proven);
+        if (!settled) {
+            proven = GenerateChildren(leaf, frame.depth + 1, token);
+            if (proven) {
+                PushFrame(&stack, leaf, frame.depth + 1);
+                continue;
+            }
+        }
+        Complete(leaf, frame.node, proven, token);
+        frame.node->dependency = std::min(frame.node->dependency, child->dependency);
+        frame.child_cut = frame.child_cut || (!proven && child->cut_off);
+    }
+    return proven;
+}
+
+void ProofTree::PushFrame(std::vector<ExpandFrame>* stack, Node* node, int depth) {
+    ExpandFrame frame{node, depth, 0, VisitOrder(node)};
+    if (profiler_ != nullptr && profiler_->Traced(depth)) {
+        frame.start = std::chrono::steady_clock::now();
+        frame.start_nodes = nodes_created_;
+    }
+    stack->push_back(frame);
+}
+
+void ProofTree::PopFrame(std::vector<ExpandFrame>* stack, bool proven) {
+    const ExpandFrame& frame = stack->back();
+    if (profiler_ != nullptr && profiler_->Traced(frame.depth)) {
+        TraceSpan span;
+        span.start = frame.start;
+        span.end = std::chrono::steady_clock::now();
+        span.thread = SearchProfiler::ThreadId();
+        span.depth = frame.depth;
+        span.nodes = nodes_created_ - frame.start_nodes;
+        span.backtracks = frame.backtracks;
+        span.proven = proven;
+        // Nodes reached by REDUCE are named after the delta child starting their chain
+        const Node* source = frame.node;
+        while (source->order_used == 0 && source->parent != nullptr) {
+            source = source->parent;
+        }
+        if (source->order_used != 0) {
+            span.delta = static_cast<int>(source->delta_used->index);
+            span.order = source->order_used;
+        }
+        profiler_->AddSpan(span);
+    }
+    stack->pop_back();
+}
+
+bool ProofTree::GenerateChildren(Node* node, int depth, const CancellationToken* token) {
+    PhaseTimer timer(profiler_.get(), SearchPhase::kGenerate);
+    if (Interrupted(token)) {
+        return false;
+    }
+    if (profiler_ != nullptr) {
+        profiler_->ReachDepth(depth);
+    }
+    if (limits_.max_depth > 0 && depth > limits_.max_depth) {
+        limit_exceeded_ = true;
+        return false;
+    }
+    if (depth_bound_ > 0 && depth > depth_bound_) {
+        node->cut_off = true;
+        return false;
+    }
+    if (progress_callback_) {
+        ReportProgress(depth);
+    }
+    node->children.clear();
+    int* counters = node->Counters();
+    const int* offsets = hints_ != nullptr ? hints_->Find(node->first, node->second) : nullptr;
+    if (offsets != nullptr) {
+        ++hinted_nodes_;
+    }
+    bool generated = true;
+    for (auto&& trans : petri_net_->GetTransitions()) {
+        size_t rs = 2 * trans.index, sr = rs + 1;
+        auto rs_child = DeltaChild(&trans, &node->first, &node->second, &counters[rs], 1,
+                                   offsets != nullptr ? offsets[rs] : 0);
+        if (rs_child == nullptr) {
+            generated = false;
+            break;
+        }
+        auto sr_child = DeltaChild(&trans, &node->second, &node->first, &counters[sr], -1,
+                                   offsets != nullptr ? offsets[sr] : 0);
+        if (sr_child == nullptr) {
+            generated = false;
+            break;
+        }
+        node->AddChild(std::move(rs_child));
+        node->AddChild(std::move(sr_child));
+    }
+    UpdatePeakMemory();
+    return generated;
+}
+
+bool ProofTree::NextChoice(Node* node, size_t index, const CancellationToken* token) {
+    PhaseTimer timer(profiler_.get(), SearchPhase::kGenerate);
+    if (Interrupted(token)) {
+        return false;
+    }
+    int* counter = &node->Counters()[index];
+    ++*counter;
+    const Transition* delta = &petri_net_->GetTransitions()[index / 2];
+    bool rs = index % 2 == 0;
+    const int* offsets = hints_ != nullptr ? hints_->Find(node->first, node->second) : nullptr;
+    auto child = DeltaChild(delta, rs ? &node->first : &node->second,
+                            rs ? &node->second : &node->first, counter, rs ? 1 : -1,
+                            offsets != nullptr ? offsets[index] : 0);
+    if (child == nullptr) {
+        return false;
+    }
+    node->ReplaceChild(index, std::move(child));
+    UpdatePeakMemory();
+    return true;
+}
+
+bool ProofTree::ReduceChildren(Node* node, int depth, const CancellationToken* token) {
+    // Children only read their ancestors, so their subtrees can be built independently. The
+    // gamma choices of one child do not depend on the others either, so a failing child tries
+    // its next choice in its own task and only a child out of choices stops its siblings.
+    size_t size = node->children.size();
+    std::vector<uint32_t> order = VisitOrder(node);
+    // Children refuted, or with iterative deepening out of choices only under the bound
+    std::vector<char> failed(size, 0), skipped(size, 0);
+    CancellationToken siblings(token);
+    auto reduce_child = [&, this](size_t index) {
+        size_t backtracks = 0;
+        bool child_cut = false;
+        while (!siblings.IsCancelled()) {
+            Node* leaf = Reduce(node->children[index].get());
+            bool proven;
+            if (!Settle(leaf, &proven)) {
+                proven = Expand(leaf, depth + 1, &siblings);
+            }
+            Complete(leaf, node, proven, &siblings);
+            // Children failing after the cancellation were stopped by it
+            if (proven || siblings.IsCancelled()) {
+                return;
+            }
+            ++backtracks;
+            if (profiler_ != nullptr) {
+                profiler_->AddBacktrack(backtracks);
+            }
+            child_cut = child_cut || node->children[index]->cut_off;
+            if (NextChoice(node, index, &siblings)) {
+                continue;
+            }
+            if (child_cut && !Interrupted(&siblings)) {
+                skipped[index] = 1;
+            } else {
+                failed[index] = 1;
+                siblings.Cancel();
+            }
+            return;
+        }
+    };
+    {
+        // The children to search first are handed to the pool first
+        TaskGroup group(pool_.get(), &siblings);
+        for (size_t i = 1; i < size; ++i) {
+            size_t index = order.empty() ? i : order[i];
+            group.Run([&reduce_child, index] { reduce_child(index); });
+        }
+        reduce_child(order.empty() ? 0 : order[0]);
+        group.Wait();
+    }
+    for (auto&& child : node->children) {
+        node->dependency = std::min(node->dependency, child->dependency);
+    }
+    if (Interrupted(token)) {
+        return false;
+    }
+    if (std::find(failed.begin(), failed.end(), 1) != failed.end()) {
+        node->cut_off = false;
+        return false;
+    }
+    bool cut_skipped = std::find(skipped.begin(), skipped.end(), 1) != skipped.end();
+    node->cut_off = cut_skipped;
+    return !cut_skipped;
+}
+
+bool ProofTree::Settle(Node* node, bool* proven) {
+    if (node->first == node->second) {
+        *proven = true;
+        return true;
+    }
+    if (!memoize_) {
+        return false;
+    }
+    PhaseTimer timer(profiler_.get(), SearchPhase::kMemo);
+    const Node* scope = nullptr;
+    if (!memo_.Find(node, proven, &scope)) {
+        if (shared_memo_ != nullptr && !certifiable_ &&
+            shared_memo_->Contains(node->first, node->second)) {
+            *proven = true;
+        } else if (refuted_.Covers(node)) {
+            ++refuted_hits_;
+            *proven = false;
+        } else {
+            ++memo_misses_;
+            return false;
+        }
+    }
+    ++memo_hits_;
+    node->memo = *proven ? 1 : -1;
+    if (scope != nullptr) {
+        node->dependency = std::min(node->dependency, scope->level);
+    }
+    return true;
+}
+
+ProofTree::Node* ProofTree::Complete(Node* node, const Node* stop, bool proven,
+                                     const CancellationToken* token) {
+    PhaseTimer timer(profiler_.get(), SearchPhase::kComplete);
+    // A failure caused by an interruption says nothing about the pair
+    bool record = memoize_ && (proven || !Interrupted(token));
     while (true) {
-        node->children.clear();
-        for (auto&& trans : petri_net_->transitions) {
-            auto rs_child = DeltaChild(trans.get(), &node->first, &node->second,
-                                       &node->rs_used[trans.get()], 1);
-            if (rs_child == nullptr) {
-                return false;
-            }
-            auto sr_child = DeltaChild(trans.get(), &node->second, &node->first,
-                                       &node->sr_used[trans.get()], -1);
-            if (sr_child == nullptr) {
-                return false;
-            }
-            node->AddChild(std::move(rs_child));
-            node->AddChild(std::move(sr_child));
-        }
-        bool all_children = true;
-        for (auto&& child : node->children) {
-            all_children = all_children && Reduce(child.get(), depth + 1);
+        if (certifiable_) {
+            // Taken before the verdict is recorded, so a verdict used by the subtree of a node
+            // was always recorded by a node finished before it
+            node->finished = ++finished_count_;
         }
-        if (all_children) {
-            return true;
+        if (certifiable_ && proven && !node->children.empty()) {
+            // Children that failed and were replaced leave their assumptions behind, which the
+            // proof does not make. The certificate only assumes what the final children do.
+            int dependency = INT_MAX;
+            for (auto&& child : node->children) {
+                dependency = std::min(dependency, child->dependency);
+                if (child->reduced_parent != nullptr) {
+                    dependency = std::min(dependency, child->reduced_parent->level);
+                }
+            }
+            node->dependency = dependency;
         }
+        // Failures cut off by the bound of iterative deepening are not refutations
+        if (record && node->memo == 0 && !(node->first == node->second) &&
+            (proven || !node->cut_off)) {
+            if (node->dependency >= node->level) {
+                memo_.Insert(node, proven, nullptr);
+                node->recorded = proven && certifiable_;
+                if (proven && shared_memo_ != nullptr) {
+                    shared_memo_->Insert(node->first, node->second);
+                } else if (!proven) {
+                    refuted_.Insert(node);
+                }
+            } else if (proven) {
+                // Completed subtrees may still be dropped by a cancelled fork along with this
+                // node, so the verdict is kept only if no fork lies between it and its scope,
+                // where the nodes using it would be dropped as well
+                const Node* scope = node;
+                bool forked = false;
+                while (scope->level > node->dependency) {
+                    scope = scope->parent;
+                    forked = forked || scope->forked;
+                }
+                if (!forked) {
+                    memo_.Insert(node, proven, scope);
+                    node->memo_source = true;
+                }
+            }
+        }
+        if (spill_ != nullptr && proven && node->dependency >= node->level &&
+            !node->children.empty()) {
+            Spill(node);
+        }
+        if (node->parent == stop) {
+            return node;
+        }
+        node->parent->dependency = std::min(node->parent->dependency, node->dependency);
+        if (!proven) {
+            node->parent->cut_off = node->cut_off;
+        }
+        node = node->parent;
     }
 }
 
-bool ProofTree::Reduce(Node* node, int depth) {
-    size_t place_num = petri_net_->GetPlaceNum();
-    Multiset intersect_r0(place_num), intersect_r0_tick(place_num), rem_r1(place_num),
-        rem_r1_tick(place_num), rem_s1(place_num), rem_s1_tick(place_num);
+ProofTree::Node* ProofTree::Reduce(Node* node) {
+    PhaseTimer timer(profiler_.get(), SearchPhase::kReduce);
     bool reduced = true;
-    while (reduced) {
-        if (node->first == node->second) {
-            return true;
-        }
-        Node* parent = node->parent;
+    while (reduced && !(node->first == node->second)) {
+        node->ComputeKey();
         reduced = false;
-        while (parent != nullptr) {
-            intersect_r0.Reset(), intersect_r0_tick.Reset(), rem_r1.Reset(), rem_r1_tick.Reset(),
-                rem_s1.Reset(), rem_s1_tick.Reset();
-            bool res_rs =  // r', s', r0, r0', r1, s1, r1', s1'
-                node->GreaterThan(&parent->first, &parent->second, &intersect_r0,
-                                  &intersect_r0_tick, &rem_r1, &rem_s1, &rem_r1_tick, &rem_s1_tick);
-            bool res_sr;
-            if (!res_rs) {
-                intersect_r0.Reset(), intersect_r0_tick.Reset(), rem_r1.Reset(),
-                    rem_r1_tick.Reset(), rem_s1.Reset(), rem_s1_tick.Reset();
-                res_sr = node->GreaterThan(&parent->second, &parent->first, &intersect_r0,
-                                           &intersect_r0_tick, &rem_r1, &rem_s1, &rem_r1_tick,
-                                           &rem_s1_tick);
-            }
-            if (res_rs || res_sr) {
-                node->AddChild(std::make_unique<Node>(
-                    node->first,
-                    Multiset::ReduceChild(intersect_r0, rem_s1_tick, rem_s1, rem_r1_tick),
-                    petri_net_->transitions, nullptr, nullptr, 0));
-                reduced = true;
-                node = node->children.back().get();
-                node->reduced_parent = parent;
-                break;
-            }
-            parent = parent->parent;
-        }
-    }
-    return Expand(node, depth + 1);
-}
-
-inline unique_ptr<ProofTree::Node> ProofTree::DeltaChild(const Transition* delta,
-                                                         const Multiset* first,
-                                                         const Multiset* second, int* counter,
-                                                         int rs_order) {
-    auto candidates = &(petri_net_->label_map[delta->label]);
-    unique_ptr<Node> res = nullptr;
-    for (; *counter < candidates->size(); (*counter)++) {
-        auto gamma = (*candidates)[*counter];
-        Multiset r_set = Multiset::WeakTransition(first, delta);
-        Multiset s_set(petri_net_->GetPlaceNum());
-        if (!Multiset::MirrorTransition(second, first, delta, gamma, &s_set)) {
+        // No ancestor above one whose path minimum exceeds our intersection can be smaller
+        for (Node* parent = node->parent;
+             parent != nullptr && node->key.intersect.Power() >= parent->key.path_min_power;
+             parent = parent->parent) {
+            bool reversed = false;
+            bool dominates = node->Dominates(parent, reversed);
+            if (!dominates) {
+                reversed = true;
+                dominates = node->Dominates(parent, reversed);
+            }
+            if (profiler_ != nullptr) {
+                profiler_->AddReduceComparison(dominates);
+            }
+            if (!dominates) {
+                continue;
+            }
+            // r0 + (s1' - s1) + r1'
+            const Multiset& other_first_rem =
+                reversed ? parent->key.second_rem : parent->key.first_rem;
+            const Multiset& other_second_rem =
+                reversed ? parent->key.first_rem : parent->key.second_rem;
+            node->AddChild(MakeNode(node->first,
+                                    Multiset::ReduceChild(node->key.intersect, other_second_rem,
+                                                          node->key.second_rem, other_first_rem),
+                                    nullptr, nullptr, 0));
+            reduced = true;
+            node->dependency = std::min(node->dependency, parent->level);
+            node = node->children.back().get();
+            node->reduced_parent = parent;
+            break;
+        }
+    }
+    return node;
+}
+
+bool ProofTree::Interrupted(const CancellationToken* token) {
+    if (limit_exceeded_) {
+        return true;
+    }
+    if (token != nullptr && token->IsCancelled()) {
+        return true;
+    }
+    bool exceeded = (limits_.max_nodes > 0 && nodes_created_ > limits_.max_nodes) ||
+                    (limits_.max_memory > 0 && MemoryUsage() > limits_.max_memory);
+    if (!exceeded && limits_.max_seconds > 0) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time_;
+        exceeded = elapsed.count() > limits_.max_seconds;
+    }
+    if (exceeded) {
+        limit_exceeded_ = true;
+    }
+    return exceeded;
+}
+
+void ProofTree::ReportProgress(int depth) {
+    auto elapsed = std::chrono::steady_clock::now() - start_time_;
+    auto next = next_report_.load(std::memory_order_relaxed);
+    if (elapsed.count() < next ||
+        !next_report_.compare_exchange_strong(next, (elapsed + progress_interval_).count())) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(progress_mutex_);
+    SearchProgress progress;
+    progress.nodes = nodes_created_;
+    progress.depth = depth;
+    progress.nodes_per_second =
+        progress.nodes / std::chrono::duration<double>(elapsed).count();
+    progress_callback_(progress);
+}
+
+size_t ProofTree::MemoryUsage() const {
+    return arena_.AllocatedBytes() + node_pool_.AllocatedBytes() + counter_bytes_ +
+           memo_.MemoryUsage() + refuted_.MemoryUsage();
+}
+
+void ProofTree::UpdatePeakMemory() {
+    size_t usage = MemoryUsage();
+    size_t peak = peak_memory_.load(std::memory_order_relaxed);
+    while (usage > peak && !peak_memory_.compare_exchange_weak(peak, usage)) {
+    }
+}
+
+ProofTree::NodePtr ProofTree::MakeNode(Multiset first, Multiset second, const Transition* delta,
+                                       const Transition* gamma, int rs_order) {
+    ++nodes_created_;
+    return NodePtr(new (node_pool_.Allocate()) Node(this, std::move(first), std::move(second),
+                                                   delta, gamma, rs_order));
+}
+
+void ProofTree::ReleaseSubtree(Node* node) {
+    // The parent links of the released nodes chain the nodes still to visit and then the
+    // visited ones, so subtrees of any depth are torn down without recursion or allocation
+    node->parent = nullptr;
+    Node* pending = node;
+    Node* visited = nullptr;
+    while (pending != nullptr) {
+        Node* current = pending;
+        pending = current->parent;
+        if (current->recorded && certifiable_) {
+            // Leaves elsewhere may be closed by its verdict
+            current->parent = nullptr;
+            KeepSubtree(current);
             continue;
         }
-        res = std::make_unique<Node>(r_set, s_set, petri_net_->transitions, delta, gamma, rs_order);
-        break;
+        if (current->memo_source) {
+            memo_.Erase(current);
+            current->memo_source = false;
+        }
+        for (auto&& child : current->children) {
+            Node* released = child.release();
+            released->parent = pending;
+            pending = released;
+        }
+        current->children.clear();
+        current->parent = visited;
+        visited = current;
+    }
+    // Blocks go back to the pool only once no scoped entry refers to a node of the subtree,
+    // as another thread may take them over while looking entries up
+    while (visited != nullptr) {
+        Node* current = visited;
+        visited = current->parent;
+        current->~Node();
+        node_pool_.Release(current);
     }
-    return res;
 }
 
-void ProofTree::PrintTree(std::basic_ofstream<char> output) {
-    std::vector<Node*> nodes;
-    std::vector<std::pair<Node*, Node*>> edges;
-    TreeTraversal(&nodes, &edges);
-    output
-        << R""""(<?xml version="1.0" encoding="UTF-8"?><graphml xmlns="http://graphml.graphdrawing.org/xmlns"><graph id="GameTree" edgedefault="directed">)"""";
-    for (int i = 0; i < nodes.size(); ++i) {
-        Node* node = nodes[i];
-        output << "<node id=\"" << i << "\" first=\"" << node->first.ToString() << "\" second=\""
-               << node->second.ToString() << "\"";
-        if (node->order_used != 0) {
-            output << " delta=\"" << node->delta_used->ToString() << "\" gamma=\""
-                   << node->gamma_used->ToString() << "\" order=\""
-                   << (node->order_used > 0 ? "direct" : "reverse") << "\"";
-        } else if (node->reduced_parent != nullptr) {
-            output << " reduced=\"" << node->reduced_parent->id << "\"";
+void ProofTree::KeepSubtree(Node* node) {
+    std::vector<Node*> stack{node};
+    while (!stack.empty()) {
+        Node* current = stack.back();
+        stack.pop_back();
+        if (current->memo_source) {
+            memo_.Erase(current);
+            current->memo_source = false;
         }
-        if (node->children.empty()) {
-            output << " terminal=\"" << (node->first == node->second ? "SUCCESS" : "FAIL") << "\"";
+        for (auto&& child : current->children) {
+            stack.push_back(child.get());
         }
-        output << "/>";
-        node->id = i;
     }
-    for (auto&& edge : edges) {
-        output << "<edge source=\"" << edge.first->id << "\" target=\"" << edge.second->id
-               << "\"/>";
+    std::lock_guard<std::mutex> lock(kept_mutex_);
+    kept_.emplace_back(node);
+}
+
+inline ProofTree::NodePtr ProofTree::DeltaChild(const Transition* delta, const Multiset* first,
+                                                const Multiset* second, int* counter,
+                                                int rs_order, int offset) {
+    auto candidates = Candidates(delta);
+    if (static_cast<size_t>(*counter) >= candidates.size) {
+        return nullptr;
+    }
+    // The weak transition does not depend on gamma, and the mirrored row is reused on failure
+    Multiset r_set = Multiset::WeakTransition(first, delta);
+    Multiset s_set(&arena_);
+    for (; static_cast<size_t>(*counter) < candidates.size; (*counter)++) {
+        size_t position = *counter + offset;
+        auto gamma = candidates[position < candidates.size ? position : position - candidates.size];
+        bool fired = Multiset::MirrorTransition(second, first, delta, gamma, &s_set);
+        if (profiler_ != nullptr) {
+            profiler_->AddCandidate(delta->index, !fired);
+        }
+        if (fired) {
+            return MakeNode(std::move(r_set), std::move(s_set), delta, gamma, rs_order);
+        }
     }
-    output << "</graph>";
+    return nullptr;
+}
+
+void ProofTree::PrintTree(const std::string& path) {
+    GraphMLWriter writer(path, petri_net_->GetPlaceNum(), TransitionStrings());
+    // Parents are visited first, so every id a node refers to is already assigned
+    TreeTraversal([&](const NodeView& node) {
+        GraphMLNode out;
+        out.id = node.id;
+        out.first = node.first;
+        out.second = node.second;
+        out.order = node.order;
+        if (node.order != 0) {
+            out.delta = node.delta;
+            out.gamma = node.gamma;
+        } else {
+            out.reduced = node.reduced;
+        }
+        out.memo = node.memo;
+        out.terminal = node.terminal;
+        out.success = node.success;
+        writer.WriteNode(out);
+        if (node.parent >= 0) {
+            writer.WriteEdge(node.parent, node.id);
+        }
+    });
+    writer.EndGraph();
+    if (success && record_basis_) {
+        writer.BeginBasis();
+        for (auto&& node : basis_.Pairs()) {
+            writer.WriteBasisPair(node->first.Data(), node->second.Data());
+        }
+    }
+    writer.Close();
+}
+
+std::vector<std::string> ProofTree::TransitionStrings() const {
+    std::vector<std::string> strings;
+    for (auto&& transition : petri_net_->GetTransitions()) {
+        strings.push_back(transition.ToString());
+    }
+    return strings;
+}
+
+void ProofTree::WriteBinary(const std::string& path) {
+    using namespace treefile;
+    size_t place_num = petri_net_->GetPlaceNum();
+    uint64_t node_count = 0;
+    int max_value = 0;
+    TreeTraversal([&](const NodeView& node) {
+        ++node_count;
+        for (const int* data : {node.first, node.second}) {
+            for (size_t i = 0; i < place_num; ++i) {
+                max_value = std::max(max_value, data[i]);
+            }
+        }
+    });
+    std::vector<const Node*> basis;
     if (success && record_basis_) {
-        output << "<basis>";
-        for (auto&& node : basis_) {
-            if (!(node->first == node->second)) {
-                output << "<pair first=\"" << node->first.ToString() << "\" second=\""
-                       << node->second.ToString() << "\"/>";
+        basis = basis_.Pairs();
+    }
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.place_num = static_cast<uint32_t>(place_num);
+    header.node_count = node_count;
+    header.transition_count = static_cast<uint32_t>(petri_net_->GetTransitions().size());
+    header.marking_bytes = MarkingBytes(max_value);
+    header.verdict = verdict_ == Verdict::kBisimilar      ? kBisimilar
+                     : verdict_ == Verdict::kNotBisimilar ? kNotBisimilar
+                                                          : kUnknown;
+    header.has_basis = success && record_basis_;
+    header.transitions_offset = sizeof(Header);
+    uint64_t transitions_size = 0;
+    for (auto&& transition : petri_net_->GetTransitions()) {
+        transitions_size += 2 * sizeof(uint32_t) + transition.id.size() + transition.label.size() +
+                            place_num * sizeof(int32_t);
+    }
+    // Node records are read in place, so they start at an aligned offset
+    header.nodes_offset = (header.transitions_offset + transitions_size + 7) / 8 * 8;
+    size_t pair_bytes = 2 * place_num * header.marking_bytes;
+    size_t stride = (sizeof(NodeRecord) + pair_bytes + 7) / 8 * 8;
+    header.basis_offset = header.nodes_offset + node_count * stride;
+    header.basis_count = basis.size();
+
+    auto output = OutputStream::Open(path);
+    auto write_raw = [&](const void* data, size_t size) {
+        output->Write(std::string_view(static_cast<const char*>(data), size));
+    };
+    write_raw(&header, sizeof(header));
+    for (auto&& transition : petri_net_->GetTransitions()) {
+        for (const std::string* text : {&transition.id, &transition.label}) {
+            auto length = static_cast<uint32_t>(text->size());
+            write_raw(&length, sizeof(length));
+            output->Write(*text);
+        }
+        for (size_t i = 0; i < place_num; ++i) {
+            auto change = static_cast<int32_t>(transition.after.Data()[i] -
+                                               transition.before.Data()[i]);
+            write_raw(&change, sizeof(change));
+        }
+    }
+    for (uint64_t i = header.transitions_offset + transitions_size; i < header.nodes_offset; ++i) {
+        output->Write('\0');
+    }
+
+    // Breadth-first numbering keeps the children of every node contiguous. Evicted subtrees are
+    // followed through the spill file, keeping the ids of the path from their root for REDUCE.
+    struct IdChain {
+        uint64_t id;
+        std::shared_ptr<const IdChain> parent;
+    };
+    struct Item {
+        Node* node;       // nullptr for a node below the root of an evicted subtree
+        uint64_t offset;  // record of such a node
+        std::shared_ptr<const IdChain> chain;
+        uint64_t id, parent;
+    };
+    std::vector<char> packed(stride - sizeof(NodeRecord), 0);
+    SpillFile::Record spilled;
+    std::queue<Item> queue;
+    uint64_t next_id = 0;
+    root_->id = static_cast<int>(next_id++);
+    queue.push({root_.get(), 0, nullptr, 0, kNone});
+    while (!queue.empty()) {
+        Item item = std::move(queue.front());
+        queue.pop();
+        NodeRecord record{};
+        record.parent = item.parent;
+        record.first_child = next_id;
+        const int* first;
+        const int* second;
+        Node* node = item.node;
+        if (node != nullptr && node->spill_offset < 0) {
+            first = node->first.Data();
+            second = node->second.Data();
+            record.reduced = node->order_used == 0 && node->reduced_parent != nullptr
+                                 ? node->reduced_parent->id
+                                 : kNone;
+            record.child_count = static_cast<uint32_t>(node->children.size());
+            record.delta =
+                node->order_used != 0 ? static_cast<int32_t>(node->delta_used->index) : -1;
+            record.gamma =
+                node->order_used != 0 ? static_cast<int32_t>(node->gamma_used->index) : -1;
+            record.order = static_cast<int8_t>(node->order_used);
+            record.memo = static_cast<int8_t>(node->memo);
+            if (node->children.empty()) {
+                record.terminal = node->first == node->second || node->memo > 0 ? 1 : 2;
+            }
+            for (auto&& child : node->children) {
+                child->id = static_cast<int>(next_id);
+                queue.push({child.get(), 0, nullptr, next_id++, item.id});
+            }
+        } else {
+            spill_->Read(node != nullptr ? node->spill_offset : item.offset, &spilled);
+            auto chain = std::make_shared<const IdChain>(
+                IdChain{item.id, node != nullptr ? nullptr : std::move(item.chain)});
+            first = spilled.first.data();
+            second = spilled.second.data();
+            record.reduced = kNone;
+            if (spilled.header.reduced_up > 0) {
+                const IdChain* ancestor = chain.get();
+                for (int up = 0; up < spilled.header.reduced_up; ++up) {
+                    ancestor = ancestor->parent.get();
+                }
+                record.reduced = ancestor->id;
+            }
+            record.child_count = spilled.header.child_count;
+            record.delta = spilled.header.delta;
+            record.gamma = spilled.header.gamma;
+            record.order = spilled.header.order;
+            record.memo = spilled.header.memo;
+            if (spilled.children.empty()) {
+                record.terminal =
+                    spilled.first == spilled.second || spilled.header.memo > 0 ? 1 : 2;
+            }
+            for (uint64_t offset : spilled.children) {
+                queue.push({nullptr, offset, chain, next_id++, item.id});
             }
         }
-        output << "</basis>";
+        write_raw(&record, sizeof(record));
+        PackMarking(first, place_num, header.marking_bytes, packed.data());
+        PackMarking(second, place_num, header.marking_bytes, packed.data() + pair_bytes / 2);
+        write_raw(packed.data(), packed.size());
     }
-    output << "</graphml>";
+    for (auto&& node : basis) {
+        PackMarking(node->first.Data(), place_num, header.marking_bytes, packed.data());
+        PackMarking(node->second.Data(), place_num, header.marking_bytes,
+                    packed.data() + pair_bytes / 2);
+        write_raw(packed.data(), pair_bytes);
+    }
+    output->Close();
 }
 
-void ProofTree::TreeTraversal(std::vector<Node*>* nodes,
-                              std::vector<std::pair<Node*, Node*>>* edges) {
-    std::stack<Node*> stack;
-    std::unordered_set<Node*> to_remove;
-    size_t n = petri_net_->GetPlaceNum();
-    Multiset m1(n), m2(n), m3(n), m4(n), m5(n), m6(n);
-    stack.emplace(root_.get());
-    while (!stack.empty()) {
-        auto current = stack.top();
-        nodes->push_back(current);
-        if (record_basis_) {
-            to_remove.clear();
-            bool insert = true;
-            for (auto&& el : basis_) {
-                m1.Reset(), m2.Reset(), m3.Reset(), m4.Reset(), m5.Reset(), m6.Reset();
-                bool direct = el->GreaterThan(&current->first, &current->second, &m1, &m2, &m3, &m4,
-                                              &m5, &m6);
-                bool reverse;
-                if (!direct) {
-                    m1.Reset(), m2.Reset(), m3.Reset(), m4.Reset(), m5.Reset(), m6.Reset();
-                    reverse = el->GreaterThan(&current->second, &current->first, &m1, &m2, &m3, &m4,
-                                              &m5, &m6);
+void ProofTree::WriteCertificate(const std::string& path) {
+    using namespace certificate;
+    if (verdict_ != Verdict::kBisimilar) {
+        throw std::logic_error("Only a proof of bisimilarity has a certificate");
+    }
+    if (memoize_ && !certifiable_) {
+        throw std::logic_error("A certificate needs a certifiable tree, see SetCertifiable");
+    }
+    size_t place_num = petri_net_->GetPlaceNum();
+    auto copy = [place_num](const int* data) {
+        return Multiset(std::vector<int>(data, data + place_num));
+    };
+    struct Entry {
+        Multiset first, second;
+        uint64_t id;
+        int scope;  // least level of the ancestors the subtree of the node assumes
+        bool closed;
+    };
+    using Entries = std::unordered_multimap<uint64_t, Entry>;
+    auto find = [](const Entries& entries, uint64_t hash, const Multiset& first,
+                   const Multiset& second) -> const Entry* {
+        auto range = entries.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            const Entry& entry = it->second;
+            if ((entry.first == first && entry.second == second) ||
+                (entry.first == second && entry.second == first)) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    };
+    // The tree and the subtrees kept apart from it
+    auto traverse_all = [this](const std::function<void(const NodeView&)>& visit) {
+        SubtreeTraversal(root_.get(), 0, visit, false);
+        for (auto&& kept : kept_) {
+            SubtreeTraversal(kept.get(), 0, visit, false);
+        }
+    };
+
+    // Only nodes with the pair of a leaf closed by the transposition table are kept as
+    // witnesses. For each such pair the node that recorded it first is found, whose subtree is
+    // copied in place of a leaf that has no witness before it.
+    Entries wanted;
+    traverse_all([&](const NodeView& node) {
+        if (node.terminal && node.memo > 0) {
+            Multiset first = copy(node.first), second = copy(node.second);
+            uint64_t hash = PairHash(first, second);
+            if (find(wanted, hash, first, second) == nullptr) {
+                wanted.emplace(hash,
+                               Entry{std::move(first), std::move(second), kNone, 0, false});
+            }
+        }
+    });
+    struct Proof {
+        Multiset first, second;
+        Node* node;
+        uint64_t offset;
+        uint64_t finished;
+    };
+    std::unordered_multimap<uint64_t, Proof> proofs;
+    traverse_all([&](const NodeView& node) {
+        if (!node.recorded) {
+            return;
+        }
+        Multiset first = copy(node.first), second = copy(node.second);
+        uint64_t hash = PairHash(first, second);
+        if (find(wanted, hash, first, second) == nullptr) {
+            return;
+        }
+        auto range = proofs.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            Proof& proof = it->second;
+            if ((proof.first == first && proof.second == second) ||
+                (proof.first == second && proof.second == first)) {
+                if (node.finished < proof.finished) {
+                    proof = Proof{std::move(first), std::move(second), node.node, node.offset,
+                                  node.finished};
                 }
-                if (direct || reverse) {
-                    to_remove.insert(el);
-                } else {
-                    m1.Reset(), m2.Reset(), m3.Reset(), m4.Reset(), m5.Reset(), m6.Reset();
-                    direct =
-                        current->GreaterThan(&el->first, &el->second, &m1, &m2, &m3, &m4, &m5, &m6);
-                    if (direct) {
-                        insert = false;
-                    }
+                return;
+            }
+        }
+        proofs.emplace(hash, Proof{std::move(first), std::move(second), node.node, node.offset,
+                                   node.finished});
+    });
+
+    // Nodes are numbered in preorder like the traversal, with the copies in place of their
+    // leaves. The rules of the verifier are followed along: a node is a witness once its subtree
+    // is finished, for any later leaf if the subtree assumes no ancestor of the node and only
+    // below the shallowest assumed ancestor otherwise.
+    struct Open {
+        uint64_t id;
+        int level;
+        Multiset first, second;
+        int assumed;          // level of the ancestor used by REDUCE for the node, INT_MAX if none
+        int inner = INT_MAX;  // least level of the ancestors assumed below the node
+    };
+    std::vector<StepRecord> steps;
+    std::vector<int> levels;  // by certificate id
+    std::vector<Open> open;   // the node emitted last and its ancestors, by level
+    Entries witnesses;
+    auto close_to = [&](int level) {
+        while (static_cast<int>(open.size()) > level) {
+            Open& done = open.back();
+            uint64_t hash = PairHash(done.first, done.second);
+            if (find(wanted, hash, done.first, done.second) != nullptr) {
+                witnesses.emplace(hash, Entry{std::move(done.first), std::move(done.second),
+                                              done.id, done.inner, done.inner >= done.level});
+            }
+            int assumed = std::min(done.inner, done.assumed);
+            open.pop_back();
+            if (!open.empty()) {
+                open.back().inner = std::min(open.back().inner, assumed);
+            }
+        }
+    };
+    auto emit = [&](int level, StepRecord step, Multiset first, Multiset second,
+                    int scope = INT_MAX) {
+        close_to(level);
+        Open node{steps.size(), level, std::move(first), std::move(second), INT_MAX, scope};
+        if (step.reduced != kNone) {
+            // Reduce tries the pair of the ancestor in its own order first
+            node.assumed = levels[step.reduced];
+            const Open& parent = open[level - 1];
+            const Open& ancestor = open[node.assumed];
+            Multiset reduced;
+            step.reversed = !ReduceStep(parent.first, parent.second, ancestor.first,
+                                        ancestor.second, false, &reduced);
+        }
+        steps.push_back(step);
+        levels.push_back(level);
+        open.push_back(std::move(node));
+        return open.back().id;
+    };
+
+    // Emits a subtree below the node emitted last. A copied subtree takes the step and the pair
+    // of the leaf it replaces, with the pair possibly in the other order. Its root was not
+    // reduced, as it assumes no ancestor, so only the orders of its delta children swap then.
+    std::function<void(Node*, uint64_t, const StepRecord*, const Multiset*, int)> emit_tree =
+        [&](Node* start, uint64_t start_offset, const StepRecord* root_step,
+            const Multiset* root_pair, int base_level) {
+        std::vector<uint64_t> ids;  // certificate id of every node, by the id of the traversal
+        bool swapped = false;
+        SubtreeTraversal(start, start_offset, [&](const NodeView& node) {
+            int level = base_level + node.level;
+            StepRecord step{};
+            Multiset first = copy(node.first), second = copy(node.second);
+            if (node.parent < 0 && root_step != nullptr) {
+                step = *root_step;
+                swapped = !(first == root_pair[0]);
+                first = root_pair[0];
+                second = root_pair[1];
+            } else {
+                step.reduced = node.reduced >= 0 ? ids[node.reduced] : kNone;
+                step.delta = node.delta;
+                step.gamma = node.gamma;
+                step.order = static_cast<int8_t>(swapped && node.level == 1 ? -node.order
+                                                                            : node.order);
+            }
+            step.witness = kNone;
+            step.child_count = static_cast<uint32_t>(node.child_count);
+            if (!node.terminal || node.memo <= 0) {
+                ids.push_back(emit(level, step, std::move(first), std::move(second)));
+                return;
+            }
+            close_to(level);
+            // The witness assumes the same ancestor as the verdict the search used, so that the
+            // nodes above assume what they did in the search and their verdicts hold where the
+            // search used them
+            int scope = node.assumed_up > 0 ? level - node.assumed_up : INT_MAX;
+            uint64_t hash = PairHash(first, second);
+            auto range = witnesses.equal_range(hash);
+            for (auto it = range.first; it != range.second; ++it) {
+                const Entry& witness = it->second;
+                if (!((witness.first == first && witness.second == second) ||
+                      (witness.first == second && witness.second == first))) {
+                    continue;
                 }
+                if (scope == INT_MAX ? witness.closed
+                                     : !witness.closed && witness.scope == scope &&
+                                           open[scope].id <= witness.id) {
+                    step.witness = witness.id;
+                    ids.push_back(emit(level, step, std::move(first), std::move(second), scope));
+                    return;
+                }
+            }
+            if (scope != INT_MAX) {
+                throw std::logic_error("The node that proved a scoped verdict was not written "
+                                       "before its use");
             }
-            for (auto&& el : to_remove) {
-                basis_.erase(el);
+            // The node that proved the pair comes later or was discarded. It finished before
+            // the leaf was closed, and so before every node using the leaf, so copies never
+            // lead back to themselves.
+            const Proof* proof = nullptr;
+            auto proof_range = proofs.equal_range(hash);
+            for (auto it = proof_range.first; it != proof_range.second; ++it) {
+                if ((it->second.first == first && it->second.second == second) ||
+                    (it->second.first == second && it->second.second == first)) {
+                    proof = &it->second;
+                }
             }
-            if (insert) {
-                basis_.insert(current);
+            if (proof == nullptr) {
+                throw std::logic_error("No proof of a pair closed by the transposition table "
+                                       "was kept");
             }
+            Multiset pair[] = {std::move(first), std::move(second)};
+            ids.push_back(steps.size());
+            emit_tree(proof->node, proof->offset, &step, pair, level);
+        }, true);
+    };
+    emit_tree(root_.get(), 0, nullptr, nullptr, 0);
+    close_to(0);
+    std::vector<const Node*> basis;
+    if (record_basis_) {
+        basis = basis_.Pairs();
+    }
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.place_num = static_cast<uint32_t>(place_num);
+    header.transition_count = static_cast<uint32_t>(petri_net_->GetTransitions().size());
+    header.net_hash = petri_net_->Fingerprint();
+    header.node_count = steps.size();
+    header.basis_count = basis.size();
+    auto output = OutputStream::Open(path);
+    auto write_raw = [&](const void* data, size_t size) {
+        output->Write(std::string_view(static_cast<const char*>(data), size));
+    };
+    auto write_marking = [&](const Multiset& marking) {
+        for (size_t i = 0; i < place_num; ++i) {
+            auto value = static_cast<int32_t>(marking.Data()[i]);
+            write_raw(&value, sizeof(value));
+        }
+    };
+    write_raw(&header, sizeof(header));
+    write_marking(root_->first);
+    write_marking(root_->second);
+    write_raw(steps.data(), steps.size() * sizeof(StepRecord));
+    for (auto&& node : basis) {
+        write_marking(node->first);
+        write_marking(node->second);
+    }
+    output->Close();
+}
+
+TreeArrays ProofTree::ToArrays() {
+    TreeArrays arrays;
+    arrays.place_num = petri_net_->GetPlaceNum();
+    int next_id = 0;
+    TreeTraversal([&](const NodeView& node) {
+        ++next_id;
+        arrays.first.insert(arrays.first.end(), node.first, node.first + arrays.place_num);
+        arrays.second.insert(arrays.second.end(), node.second, node.second + arrays.place_num);
+        arrays.parent.push_back(node.parent);
+        if (node.parent >= 0) {
+            arrays.edges.push_back(node.parent);
+            arrays.edges.push_back(node.id);
+        }
+        bool expanded = node.order != 0;
+        arrays.delta.push_back(node.delta);
+        arrays.gamma.push_back(node.gamma);
+        arrays.order.push_back(static_cast<int8_t>(node.order));
+        arrays.reduced.push_back(!expanded ? node.reduced : -1);
+        arrays.memo.push_back(static_cast<int8_t>(node.memo));
+        int8_t terminal = 0;
+        if (node.terminal) {
+            terminal = node.success ? 1 : 2;
+        }
+        arrays.terminal.push_back(terminal);
+    });
+    arrays.node_count = next_id;
+    if (success && record_basis_) {
+        for (auto&& node : basis_.Pairs()) {
+            const int* first = node->first.Data();
+            const int* second = node->second.Data();
+            arrays.basis_first.insert(arrays.basis_first.end(), first, first + arrays.place_num);
+            arrays.basis_second.insert(arrays.basis_second.end(), second,
+                                       second + arrays.place_num);
+            ++arrays.basis_count;
+        }
+    }
+    return arrays;
+}
+
+void ProofTree::TreeTraversal(const std::function<void(const NodeView&)>& visit,
+                              bool finish_order) {
+    // The tree does not change once checked, so later traversals reuse the basis
+    bool update_basis = record_basis_ && !basis_ready_;
+    if (update_basis) {
+        basis_.Clear();
+    }
+    SubtreeTraversal(root_.get(), 0, [&](const NodeView& view) {
+        if (view.node != nullptr) {
+            view.node->id = view.id;
+        }
+        visit(view);
+        if (update_basis && view.node != nullptr) {
+            basis_.Update(view.node);
         }
+    }, finish_order);
+    basis_ready_ = record_basis_;
+}
+
+void ProofTree::SubtreeTraversal(Node* start, uint64_t start_offset,
+                                 const std::function<void(const NodeView&)>& visit,
+                                 bool finish_order) {
+    // A node in memory, or a node below the root of an evicted subtree and its record
+    struct Item {
+        Node* node;
+        uint64_t offset;
+        int level;
+    };
+    std::stack<Item> stack;
+    std::vector<int> path;  // ids of the visited node and its ancestors, by level
+    SpillFile::Record spilled;
+    // REDUCE refers to the levels of the tree, the ancestors of the start are not visited
+    int base_level = start != nullptr ? start->level : 0;
+    int next_id = 0;
+    stack.push({start, start_offset, 0});
+    while (!stack.empty()) {
+        Item current = stack.top();
         stack.pop();
+        NodeView view;
+        view.id = next_id++;
+        path.resize(current.level + 1);
+        path[current.level] = view.id;
+        view.level = current.level;
+        if (current.level > 0) {
+            view.parent = path[current.level - 1];
+        }
+        Node* node = current.node;
+        if (node != nullptr && node->spill_offset < 0) {
+            view.node = node;
+            view.first = node->first.Data();
+            view.second = node->second.Data();
+            view.order = node->order_used;
+            if (node->order_used != 0) {
+                view.delta = static_cast<int>(node->delta_used->index);
+                view.gamma = static_cast<int>(node->gamma_used->index);
+            } else if (node->reduced_parent != nullptr && current.level > 0) {
+                view.reduced = path[node->reduced_parent->level - base_level];
+            }
+            view.memo = node->memo;
+            view.child_count = node->children.size();
+            view.terminal = node->children.empty();
+            view.success = node->first == node->second || node->memo > 0;
+            view.recorded = node->recorded;
+            view.finished = node->finished;
+            view.assumed_up = node->AssumedUp();
+            visit(view);
+            std::vector<Node*> children;
+            for (auto&& child : node->children) {
+                children.push_back(child.get());
+            }
+            if (finish_order) {
+                std::stable_sort(children.begin(), children.end(),
+                                 [](const Node* left, const Node* right) {
+                                     return left->finished < right->finished;
+                                 });
+                std::reverse(children.begin(), children.end());
+            }
+            for (Node* child : children) {
+                stack.push({child, 0, current.level + 1});
+            }
+            continue;
+        }
+        view.offset = node != nullptr ? node->spill_offset : current.offset;
+        spill_->Read(view.offset, &spilled);
+        view.first = spilled.first.data();
+        view.second = spilled.second.data();
+        view.order = spilled.header.order;
+        view.delta = spilled.header.delta;
+        view.gamma = spilled.header.gamma;
+        if (spilled.header.reduced_up > 0 && spilled.header.reduced_up <= current.level) {
+            view.reduced = path[current.level - spilled.header.reduced_up];
+        }
+        view.memo = spilled.header.memo;
+        view.child_count = spilled.children.size();
+        view.terminal = spilled.children.empty();
+        view.success = spilled.first == spilled.second || spilled.header.memo > 0;
+        view.recorded = spilled.header.recorded != 0;
+        view.finished = spilled.header.finished;
+        view.assumed_up = spilled.header.assumed_up;
+        visit(view);
+        for (size_t i = 0; i < spilled.children.size(); ++i) {
+            size_t index = finish_order ? spilled.children.size() - 1 - i : i;
+            stack.push({nullptr, spilled.children[index], current.level + 1});
+        }
+    }
+}
+
+void ProofTree::Spill(Node* node) {
+    // Children are written before their parents, which refer to them by offset, in the order
+    // they were finished for a certifiable tree and in their own order otherwise
+    struct Item {
+        Node* node;
+        std::vector<Node*> order;
+        size_t next_child;
+        std::vector<uint64_t> children;
+    };
+    auto make_item = [this](Node* current) {
+        Item item{current, {}, 0, {}};
         for (auto&& child : current->children) {
-            stack.emplace(child.get());
-            edges->emplace_back(current, child.get());
+            item.order.push_back(child.get());
         }
+        if (certifiable_) {
+            std::stable_sort(item.order.begin(), item.order.end(),
+                             [](const Node* left, const Node* right) {
+                                 return left->finished < right->finished;
+                             });
+        }
+        return item;
+    };
+    std::vector<Item> stack;
+    stack.push_back(make_item(node));
+    size_t written = 0;
+    while (true) {
+        Item& item = stack.back();
+        if (item.next_child < item.order.size()) {
+            Node* child = item.order[item.next_child++];
+            if (child->spill_offset >= 0) {
+                item.children.push_back(static_cast<uint64_t>(child->spill_offset));
+            } else {
+                stack.push_back(make_item(child));
+            }
+            continue;
+        }
+        Node* current = item.node;
+        SpillFile::RecordHeader header{};
+        header.order = static_cast<int8_t>(current->order_used);
+        header.delta =
+            current->order_used != 0 ? static_cast<int32_t>(current->delta_used->index) : -1;
+        header.gamma =
+            current->order_used != 0 ? static_cast<int32_t>(current->gamma_used->index) : -1;
+        if (current->order_used == 0 && current->reduced_parent != nullptr) {
+            header.reduced_up = current->level - current->reduced_parent->level;
+        }
+        header.memo = static_cast<int8_t>(current->memo);
+        header.recorded = current->recorded ? 1 : 0;
+        header.finished = current->finished;
+        header.assumed_up = current->AssumedUp();
+        header.child_count = static_cast<uint32_t>(item.children.size());
+        uint64_t offset = spill_->Append(header, current->first.Data(), current->second.Data(),
+                                         item.children.data());
+        ++written;
+        stack.pop_back();
+        if (stack.empty()) {
+            node->spill_offset = static_cast<int64_t>(offset);
+            break;
+        }
+        // The record takes the place of the node, which is not kept on release
+        current->recorded = false;
+        stack.back().children.push_back(offset);
     }
+    // The subtree assumes nothing outside of it, so the scoped verdicts its nodes take along
+    // could not be used anywhere else
+    node->children.clear();
+    spilled_nodes_ += written;
 }
 
-ProofTree::Node::Node(Multiset first, Multiset second,
-                      const std::vector<unique_ptr<Transition>>& trans, const Transition* delta,
+ProofTree::Node::Node(ProofTree* tree, Multiset first, Multiset second, const Transition* delta,
                       const Transition* gamma, int rs_order)
-    : first(std::move(first)),
+    : tree(tree),
+      first(std::move(first)),
       second(std::move(second)),
       delta_used(delta),
       gamma_used(gamma),
       order_used(rs_order) {
-    for (auto&& t : trans) {
-        rs_used[t.get()] = 0;
-        sr_used[t.get()] = 0;
+}
+
+ProofTree::Node::~Node() {
+    if (memo_source) {
+        tree->memo_.Erase(this);
     }
+    if (heap_counters != nullptr) {
+        tree->counter_bytes_ -= 2 * tree->petri_net_->GetTransitions().size() * sizeof(int);
+    }
+}
+
+int* ProofTree::Node::Counters() {
+    size_t size = 2 * tree->petri_net_->GetTransitions().size();
+    if (size <= kInlineCounters) {
+        return inline_counters;
+    }
+    if (heap_counters == nullptr) {
+        heap_counters = std::make_unique<int[]>(size);
+        tree->counter_bytes_ += size * sizeof(int);
+    }
+    return heap_counters.get();
+}
+
+void ProofTree::NodeDeleter::operator()(Node* node) const {
+    node->tree->ReleaseSubtree(node);
 }
 
-void ProofTree::Node::AddChild(unique_ptr<Node> child) {
+void ProofTree::Node::AddChild(NodePtr child) {
     child->parent = this;
+    child->level = level + 1;
     children.push_back(std::move(child));
 }
 
+void ProofTree::Node::ReplaceChild(size_t index, NodePtr child) {
+    child->parent = this;
+    child->level = level + 1;
+    children[index] = std::move(child);
+}
+
+void ProofTree::Node::Reset() {
+    children.clear();
+    int* counters = Counters();
+    std::fill(counters, counters + 2 * tree->petri_net_->GetTransitions().size(), 0);
+    dependency = INT_MAX;
+    memo = 0;
+    cut_off = false;
+    spill_offset = -1;
+}
+
 // r', s', r0, r0', r1, s1, r1', s1'
-bool ProofTree::Node::GreaterThan(Multiset* other_first, Multiset* other_second,
-                                  Multiset* this_intersect, Multiset* other_intersect,
-                                  Multiset* this_first_rem, Multiset* this_second_rem,
-                                  Multiset* other_first_rem, Multiset* other_second_rem) const {
-    if (first == second) {
-        if (*other_first == *other_second) {
-            return other_first->SubsetOf(first);
-        }
+void ProofTree::Node::ComputeKey() {
+    key.Split(first, second);
+    key.path_min_power = key.intersect.Power();
+    if (parent != nullptr) {
+        key.path_min_power = std::min(key.path_min_power, parent->key.path_min_power);
+    }
+}
+
+bool ProofTree::Node::Dominates(const Node* other, bool reversed) const {
+    return key.Dominates(other->key, reversed);
+}
+
+int ProofTree::Node::AssumedUp() const {
+    return memo > 0 && children.empty() && dependency < level ? level - dependency : 0;
+}
+
+void ProofTree::SplitKey::Split(const Multiset& first, const Multiset& second) {
+    first_rem = Multiset::SameStorage(first);
+    second_rem = Multiset::SameStorage(first);
+    intersect = Multiset::SplitIntersection(&first, &second, &first_rem, &second_rem);
+    intersect_mask = intersect.SupportMask();
+    first_rem_mask = first_rem.SupportMask();
+    second_rem_mask = second_rem.SupportMask();
+}
+
+bool ProofTree::SplitKey::Dominates(const SplitKey& other, bool reversed) const {
+    // Identical pairs have no remainders and are never below a non-identical one
+    if (other.first_rem.Power() == 0 && other.second_rem.Power() == 0) {
         return false;
     }
-    if (*other_first == *other_second) {
+    const Multiset& other_first_rem = reversed ? other.second_rem : other.first_rem;
+    const Multiset& other_second_rem = reversed ? other.first_rem : other.second_rem;
+    uint64_t other_first_mask = reversed ? other.second_rem_mask : other.first_rem_mask;
+    uint64_t other_second_mask = reversed ? other.first_rem_mask : other.second_rem_mask;
+    if ((other.intersect_mask & ~intersect_mask) != 0 ||
+        (other_first_mask & ~first_rem_mask) != 0 ||
+        (other_second_mask & ~second_rem_mask) != 0) {
         return false;
     }
-    *this_intersect = Multiset::SplitIntersection(&first, &second, this_first_rem, this_second_rem);
-    *other_intersect =
-        Multiset::SplitIntersection(other_first, other_second, other_first_rem, other_second_rem);
-    return other_intersect->SubsetOf(*this_intersect) &&
-           other_first_rem->SubsetOf(*this_first_rem) &&
-           other_second_rem->SubsetOf(*this_second_rem);
+    return other.intersect.SubsetOf(intersect) && other_first_rem.SubsetOf(first_rem) &&
+           other_second_rem.SubsetOf(second_rem);
+}
+
+void ProofTree::BasisIndex::Update(Node* node) {
+    bool identity = node->first == node->second;
+    if (!identity && node->key.intersect.Length() == 0) {
+        // Leaves closed before REDUCE have no key yet
+        node->ComputeKey();
+    }
+    Elements& elements = identity ? identities_ : pairs_;
+    uint64_t power = node->first.Power() + node->second.Power();
+    // Elements greater than the node have no less power and are replaced by it
+    std::vector<Elements::iterator> covering;
+    for (auto it = elements.lower_bound(power); it != elements.end(); ++it) {
+        if (Covers(it->second, node, identity)) {
+            covering.push_back(it);
+        }
+    }
+    // Any other element below the node keeps it out, those have no more power
+    bool insert = true;
+    for (auto it = elements.begin(), end = elements.upper_bound(power); it != end; ++it) {
+        if (Below(it->second, node, identity) && !Covers(it->second, node, identity)) {
+            insert = false;
+            break;
+        }
+    }
+    for (auto it : covering) {
+        elements.erase(it);
+    }
+    if (insert) {
+        elements.emplace(power, node);
+    }
+}
+
+std::vector<const ProofTree::Node*> ProofTree::BasisIndex::Pairs() const {
+    std::vector<const Node*> pairs;
+    pairs.reserve(pairs_.size());
+    for (auto&& [power, node] : pairs_) {
+        pairs.push_back(node);
+    }
+    return pairs;
+}
+
+void ProofTree::BasisIndex::Clear() {
+    pairs_.clear();
+    identities_.clear();
+}
+
+bool ProofTree::BasisIndex::Covers(const Node* element, const Node* node, bool identity) {
+    if (identity) {
+        return node->first.SubsetOf(element->first);
+    }
+    return element->Dominates(node, false) || element->Dominates(node, true);
+}
+
+bool ProofTree::BasisIndex::Below(const Node* element, const Node* node, bool identity) {
+    if (identity) {
+        return element->first.SubsetOf(node->first);
+    }
+    return node->Dominates(element, false);
+}
+
+ProofTree::MemoTable::MemoTable(MarkingArena* arena) : arena_(arena) {
+}
+
+void ProofTree::MemoTable::SetConcurrent(bool concurrent) {
+    concurrent_ = concurrent;
+}
+
+bool ProofTree::MemoTable::Find(const Node* node, bool* proven, const Node** scope) const {
+    std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+    if (concurrent_) {
+        lock.lock();
+    }
+    auto range = entries_.equal_range(PairHash(node->first, node->second));
+    for (auto it = range.first; it != range.second; ++it) {
+        const Entry& entry = it->second;
+        if (!SamePair(entry, node)) {
+            continue;
+        }
+        if (entry.scope != nullptr) {
+            // The scope has to be an ancestor of the node
+            const Node* ancestor = node;
+            while (ancestor != nullptr && ancestor->level > entry.scope->level) {
+                ancestor = ancestor->parent;
+            }
+            if (ancestor != entry.scope) {
+                continue;
+            }
+        }
+        *proven = entry.proven;
+        *scope = entry.scope;
+        return true;
+    }
+    return false;
+}
+
+void ProofTree::MemoTable::Insert(const Node* node, bool proven, const Node* scope) {
+    Entry entry{Multiset(node->first, arena_), Multiset(node->second, arena_), proven, scope,
+                scope != nullptr ? node : nullptr};
+    uint64_t hash = PairHash(node->first, node->second);
+    std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+    if (concurrent_) {
+        lock.lock();
+    }
+    entries_.emplace(hash, std::move(entry));
+    ++size_;
+}
+
+void ProofTree::MemoTable::Erase(const Node* source) {
+    std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+    if (concurrent_) {
+        lock.lock();
+    }
+    auto range = entries_.equal_range(PairHash(source->first, source->second));
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.source == source) {
+            entries_.erase(it);
+            --size_;
+            return;
+        }
+    }
+}
+
+size_t ProofTree::MemoTable::MemoryUsage() const {
+    // Hash nodes hold the key, the entry and a link, plus a bucket pointer
+    return size_ * (sizeof(Entry) + sizeof(uint64_t) + 2 * sizeof(void*));
+}
+
+size_t ProofTree::MemoTable::ImportUnscoped(const MemoTable& other) {
+    size_t count = 0;
+    for (auto&& [hash, entry] : other.entries_) {
+        if (entry.scope != nullptr) {
+            continue;
+        }
+        entries_.emplace(hash, Entry{Multiset(entry.first, arena_), Multiset(entry.second, arena_),
+                                     entry.proven, nullptr, nullptr});
+        ++count;
+    }
+    size_ += count;
+    return count;
+}
+
+bool ProofTree::MemoTable::SamePair(const Entry& entry, const Node* node) {
+    return (entry.first == node->first && entry.second == node->second) ||
+           (entry.first == node->second && entry.second == node->first);
+}
+
+void* ProofTree::NodePool::Allocate() {
+    std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+    if (concurrent_) {
+        lock.lock();
+    }
+    if (!free_nodes_.empty()) {
+        void* block = free_nodes_.back();
+        free_nodes_.pop_back();
+        return block;
+    }
+    if (slab_used_ == kNodesPerSlab) {
+        slabs_.push_back(std::make_unique<Block[]>(kNodesPerSlab));
+        ++slab_num_;
+        slab_used_ = 0;
+    }
+    return &slabs_.back()[slab_used_++];
+}
+
+void ProofTree::NodePool::Release(void* block) {
+    std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+    if (concurrent_) {
+        lock.lock();
+    }
+    free_nodes_.push_back(block);
+}
+
+void ProofTree::NodePool::SetConcurrent(bool concurrent) {
+    concurrent_ = concurrent;
+}
+
+size_t ProofTree::NodePool::AllocatedBytes() const {
+    return slab_num_ * kNodesPerSlab * sizeof(Block);
+}
+
+ProofTree::RefutedPairs::RefutedPairs(MarkingArena* arena) : arena_(arena) {
+}
+
+void ProofTree::RefutedPairs::SetConcurrent(bool concurrent) {
+    concurrent_ = concurrent;
+}
+
+bool ProofTree::RefutedPairs::Covers(const Node* node) const {
+    uint64_t hash = PairHash(node->key.first_rem, node->key.second_rem);
+    std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+    if (concurrent_) {
+        lock.lock();
+    }
+    return CoversLocked(node, hash);
+}
+
+void ProofTree::RefutedPairs::Insert(const Node* node) {
+    uint64_t hash = PairHash(node->key.first_rem, node->key.second_rem);
+    std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+    if (concurrent_) {
+        lock.lock();
+    }
+    if (CoversLocked(node, hash)) {
+        return;
+    }
+    auto range = entries_.equal_range(hash);
+    for (auto it = range.first; it != range.second;) {
+        const Entry& entry = it->second;
+        if ((entry.intersect_mask & ~node->key.intersect_mask) == 0 &&
+            (SameRemainders(entry, node, false) || SameRemainders(entry, node, true)) &&
+            entry.intersect.SubsetOf(node->key.intersect)) {
+            it = entries_.erase(it);
+            --size_;
+        } else {
+            ++it;
+        }
+    }
+    entries_.emplace(hash, Entry{Multiset(node->key.first_rem, arena_),
+                                 Multiset(node->key.second_rem, arena_),
+                                 Multiset(node->key.intersect, arena_), node->key.intersect_mask});
+    ++size_;
+}
+
+size_t ProofTree::RefutedPairs::Import(const RefutedPairs& other) {
+    for (auto&& [hash, entry] : other.entries_) {
+        entries_.emplace(hash, Entry{Multiset(entry.first_rem, arena_),
+                                     Multiset(entry.second_rem, arena_),
+                                     Multiset(entry.intersect, arena_), entry.intersect_mask});
+    }
+    size_ += other.entries_.size();
+    return other.entries_.size();
+}
+
+size_t ProofTree::RefutedPairs::MemoryUsage() const {
+    return size_ * (sizeof(Entry) + sizeof(uint64_t) + 2 * sizeof(void*));
+}
+
+bool ProofTree::RefutedPairs::SameRemainders(const Entry& entry, const Node* node,
+                                             bool reversed) {
+    const Multiset& first_rem = reversed ? node->key.second_rem : node->key.first_rem;
+    const Multiset& second_rem = reversed ? node->key.first_rem : node->key.second_rem;
+    return entry.first_rem == first_rem && entry.second_rem == second_rem;
+}
+
+bool ProofTree::RefutedPairs::CoversLocked(const Node* node, uint64_t hash) const {
+    auto range = entries_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        const Entry& entry = it->second;
+        if ((node->key.intersect_mask & ~entry.intersect_mask) == 0 &&
+            (SameRemainders(entry, node, false) || SameRemainders(entry, node, true)) &&
+            node->key.intersect.SubsetOf(entry.intersect)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ProofTree::GammaHints::GammaHints(size_t place_num) : arena_(place_num) {
+}
+
+void ProofTree::GammaHints::Insert(const Multiset& first, const Multiset& second,
+                                   std::vector<int> offsets) {
+    entries_.emplace(PairHash(first, second),
+                     Entry{Multiset(first, &arena_), Multiset(second, &arena_), std::move(offsets)});
+}
+
+const int* ProofTree::GammaHints::Find(const Multiset& first, const Multiset& second) const {
+    auto range = entries_.equal_range(PairHash(first, second));
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.first == first && it->second.second == second) {
+            return it->second.offsets.data();
+        }
+    }
+    return nullptr;
 }
@@ -1,99 +1,899 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <climits>
 #include <memory>
-#include <unordered_set>
-#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
 #include <stack>
 #include <unordered_map>
 #include "petrinet.h"
+#include "profiler.h"
+#include "spillfile.h"
+#include "threadpool.h"
 
 using std::unique_ptr;
 
+/**
+ * Result of a bisimilarity check
+ */
+enum class Verdict { kNotBisimilar, kBisimilar, kUnknown };
+
+/**
+ * Budgets of a single check, zero meaning unlimited. A check that runs out of any of them ends
+ * with Verdict::kUnknown.
+ */
+struct SearchLimits {
+    int max_depth = 0;        // nested EXPAND steps on one branch
+    size_t max_nodes = 0;     // nodes created over the whole search
+    size_t max_memory = 0;    // estimated bytes held by the tree
+    double max_seconds = 0;  // wall-clock time
+};
+
+/**
+ * Order in which the delta children of a node are searched
+ */
+enum class ChildOrder {
+    kNet,            // by transition, rs before sr
+    kFarthestFirst,  // pairs with the most tokens outside of their intersection first, as the
+                     // likeliest to fail
+};
+
+/**
+ * Order in which the gamma candidates mirroring a delta are tried
+ */
+enum class GammaOrder {
+    kNet,           // candidates of the label in the order of the net
+    kClosestFirst,  // candidates with the before and after rows closest to those of delta first
+};
+
+/**
+ * Order in which a check explores the tree. The verdict does not depend on it, only the time
+ * taken and the proof found.
+ */
+struct SearchStrategy {
+    // Iterative deepening: the EXPAND steps on a branch are bounded by this many in the first
+    // pass and by as many more in every pass after one cut short by the bound, 0 to search
+    // depth-first without a bound
+    int deepening_step = 0;
+    ChildOrder child_order = ChildOrder::kNet;
+    GammaOrder gamma_order = GammaOrder::kNet;
+};
+
+/**
+ * Snapshot of a running check passed to the progress callback
+ */
+struct SearchProgress {
+    size_t nodes = 0;               // nodes created so far
+    int depth = 0;                  // depth of the node being expanded
+    double nodes_per_second = 0;
+};
+
+/**
+ * Counters of a finished or running check
+ */
+struct SearchStats {
+    size_t nodes_created = 0;
+    size_t memo_hits = 0;    // pairs closed by the transposition table
+    size_t memo_misses = 0;  // pairs looked up and expanded
+    size_t refuted_hits = 0;  // pairs closed as covered by a refuted pair, see RefutedPairs
+    size_t peak_memory = 0;  // estimated bytes, sampled whenever a node is expanded
+    double seconds = 0;      // wall-clock time of the check
+    size_t reused_pairs = 0;  // verdicts taken over from a previous tree, see ProofTree::Reuse
+    size_t hinted_nodes = 0;  // nodes that tried the gamma choices of a previous tree first
+    size_t spilled_nodes = 0;  // nodes evicted to the spill file, see ProofTree::SetSpilling
+    size_t deepening_passes = 0;  // passes of iterative deepening, 0 without it
+    bool profiled = false;   // the profile is filled, see ProofTree::SetProfiling
+    SearchProfile profile;
+};
+
+/**
+ * The whole tree as flat arrays, nodes numbered as in ProofTree::PrintTree. Markings are
+ * row-major, one row of place_num values per node or basis pair.
+ */
+struct TreeArrays {
+    size_t node_count = 0;
+    size_t place_num = 0;
+    std::vector<int32_t> first, second;
+    std::vector<int64_t> parent;   // -1 for the root
+    std::vector<int64_t> edges;    // (parent, child) pairs in the order of the nodes
+    std::vector<int32_t> delta;    // transition index, -1 if the node is not a delta child
+    std::vector<int32_t> gamma;
+    std::vector<int8_t> order;     // 1 - rs, 0 - none, -1 - sr
+    std::vector<int64_t> reduced;  // ancestor used by REDUCE, -1 if none
+    std::vector<int8_t> memo;      // 1 - closed as proven, 0 - none, -1 - closed as refuted
+    std::vector<int8_t> terminal;  // 0 - inner node, 1 - success, 2 - failure
+    size_t basis_count = 0;
+    std::vector<int32_t> basis_first, basis_second;
+};
+
+/**
+ * Pairs proven bisimilar, shared by the checks of one net
+ *
+ * Only verdicts that assume no pair outside of their subtree are shared, so every entry holds in
+ * any tree over the net. Trees consult it after their own transposition table.
+ */
+class SharedMemo {
+public:
+    explicit SharedMemo(size_t place_num);
+
+    SharedMemo(const SharedMemo&) = delete;
+    SharedMemo& operator=(const SharedMemo&) = delete;
+
+    /**
+     * @return true if the pair is known to be bisimilar, in either order
+     */
+    [[nodiscard]] bool Contains(const Multiset& first, const Multiset& second) const;
+
+    /**
+     * Records a pair proven bisimilar, unless it is already known
+     */
+    void Insert(const Multiset& first, const Multiset& second);
+
+    [[nodiscard]] size_t Size() const;
+
+private:
+    bool ContainsLocked(const Multiset& first, const Multiset& second, uint64_t hash) const;
+
+    mutable std::shared_mutex mutex_;
+    MarkingArena arena_;
+    std::unordered_multimap<uint64_t, std::pair<Multiset, Multiset>> entries_;
+};
+
 /**
  * Proof tree we are constructing
  */
 class ProofTree {
 public:
-    ProofTree(Multiset first, Multiset second, PetriNet* net, bool record_basis);
+    /**
+     * Creates the tree for a pair of resources
+     * @param thread_num number of threads reducing independent children, 1 for sequential search.
+     * The verdict does not depend on it. The tree does on the timing of the threads, except for
+     * a proof without memoization, as concurrent subtrees find different pairs decided in the
+     * transposition table and a refutation cancels its siblings wherever they were.
+     */
+    ProofTree(Multiset first, Multiset second, PetriNet* net, bool record_basis,
+              size_t thread_num = 1);
+
+    ~ProofTree();
+
+    void SetLimits(const SearchLimits& limits);
+
+    /**
+     * Sets the order of the search, depth-first in the order of the net by default. Set before
+     * Reuse, which records the gamma choices of the previous tree as positions in this order.
+     */
+    void SetStrategy(const SearchStrategy& strategy);
+
+    /**
+     * Sets a token that stops the search from another thread, the check then ends with
+     * Verdict::kUnknown
+     * @param token token owned by the caller, nullptr to disable
+     */
+    void SetCancellation(const CancellationToken* token);
+
+    /**
+     * Sets a callback reporting the progress of the search. It is called at most once per
+     * interval and never concurrently, though possibly from a worker thread.
+     * @param callback callback to call, empty to disable
+     * @param interval minimal number of seconds between two calls
+     */
+    void SetProgressCallback(std::function<void(const SearchProgress&)> callback,
+                             double interval);
+
+    /**
+     * Enables the transposition table closing pairs already decided elsewhere in the tree,
+     * enabled by default
+     */
+    void SetMemoization(bool enabled);
+
+    /**
+     * Shares the pairs proven bisimilar with other checks of the net, used only with memoization
+     * @param shared table to consult and extend, nullptr to stop sharing
+     */
+    void SetSharedMemo(SharedMemo* shared);
+
+    /**
+     * Keeps what WriteCertificate needs, disabled by default. The subtree of a node that recorded
+     * a verdict holding anywhere is kept when the search discards it, and the order in which the
+     * nodes were finished is recorded. The tree takes no verdicts of other checks, which it could
+     * not prove, from the shared table or from Reuse, though it still adds its own to the shared
+     * table. Set before Reuse and CheckBisimilarity.
+     */
+    void SetCertifiable(bool enabled);
+
+    /**
+     * Counts the work of the search in detail and times its phases, disabled by default. The
+     * expanded subtrees near the root are recorded for WriteTrace.
+     * @param enabled profile the next check
+     * @param trace_depth record the subtrees expanded at a lower depth, 0 to record none
+     */
+    void SetProfiling(bool enabled, int trace_depth = 0);
+
+    /**
+     * Prepares a re-check after a small change of the resources or of the net, before
+     * CheckBisimilarity. Nodes whose pair was expanded by the previous tree try its gamma
+     * choices first, matching the transitions by id, so an unaffected subtree is validated
+     * again without searching. If the net has the same transitions, the verdicts of the
+     * previous tree that assume no ancestor are taken over as well, only the refutations for a
+     * certifiable tree. Nothing is reused if the number of places changed.
+     * @param previous finished tree, only read during the call
+     */
+    void Reuse(const ProofTree& previous);
+
+    /**
+     * Evicts the proven subtrees that assume no pair outside of themselves to an append-only
+     * spill file once they are complete, disabled by default. REDUCE and the transposition
+     * table never look into such subtrees again, so only the branches being searched, their
+     * ancestors and the roots of the evicted subtrees stay in memory. The writers read the
+     * evicted nodes back. Set before CheckBisimilarity.
+     * @param path path to the scratch file, removed with the tree, empty to disable
+     * @throws std::invalid_argument if the tree records a basis, which compares every node
+     * @throws std::runtime_error if the file cannot be created
+     */
+    void SetSpilling(const std::string& path);
+
+    [[nodiscard]] SearchStats Stats() const;
+
+    /**
+     * Writes the subtrees recorded by a profiled check as a Chrome trace, with the counters of the
+     * profile in its metadata
+     * @param path path to the file, compressed with gzip or zstd if it ends with .gz or .zst
+     * @throws std::logic_error if the check was not profiled
+     */
+    void WriteTrace(const std::string& path) const;
 
     /**
      * Builds the proof tree
-     * @return true if the tree is correct, false otherwise
+     * @return kBisimilar if the tree is correct, kNotBisimilar if it is not, kUnknown if the
+     * search ran out of its limits
+     */
+    Verdict CheckBisimilarity();
+
+    /**
+     * Writes the tree and the basis to a GraphML file in a single streaming pass
+     * @param path path to the file, compressed with gzip or zstd if it ends with .gz or .zst
+     */
+    void PrintTree(const std::string& path);
+
+    /**
+     * Writes the tree and the basis in the memory-mappable binary format of treefile.h, which
+     * TreeFile reads back one node at a time
+     * @param path path to the file
+     */
+    void WriteBinary(const std::string& path);
+
+    /**
+     * Writes a proof certificate of the format of certificate.h, the steps of the tree without
+     * their markings, which VerifyCertificate checks in one pass without searching. Children
+     * come in the order they were finished, so a leaf closed by the transposition table refers
+     * to the earlier node that proved its pair. If that node was finished later in another
+     * branch or discarded, the subtree kept for the verdict is copied in place of the leaf.
+     * @param path path to the file
+     * @throws std::logic_error if the resources were not proven bisimilar, or if the tree used
+     * the transposition table without being certifiable, see SetCertifiable
+     */
+    void WriteCertificate(const std::string& path);
+
+    /**
+     * Copies the tree and the basis into flat arrays, for handing to Python without a file
+     */
+    TreeArrays ToArrays();
+
+    /**
+     * @return Transition::ToString of every transition of the net, by index
+     */
+    [[nodiscard]] std::vector<std::string> TransitionStrings() const;
+
+    /**
+     * Intersection and remainders of a pair, the key of the REDUCE ordering
      */
-    bool CheckBisimilarity();
+    struct SplitKey {
+        /**
+         * Splits a pair into its intersection and remainders, allocated like the first marking
+         */
+        void Split(const Multiset& first, const Multiset& second);
 
-    void PrintTree(std::basic_ofstream<char> output);
+        /**
+         * Computes partial ordering for REDUCE
+         * @param other key of the ancestor to compare with
+         * @param reversed compare with the ancestor's pair taken in the (second, first) order
+         * @return true if this key is greater than the other, false otherwise
+         */
+        [[nodiscard]] bool Dominates(const SplitKey& other, bool reversed) const;
+
+        Multiset intersect, first_rem, second_rem;
+        uint64_t intersect_mask = 0, first_rem_mask = 0, second_rem_mask = 0;
+        // Least intersection power over this node and its ancestors
+        uint64_t path_min_power = UINT64_MAX;
+    };
 
 private:
+    struct Node;
+
+    /**
+     * Returns a node and its whole subtree to the node pool of their tree
+     */
+    struct NodeDeleter {
+        void operator()(Node* node) const;
+    };
+
+    using NodePtr = unique_ptr<Node, NodeDeleter>;
+
     /**
      * Node of the proof tree
      */
     struct Node {
-        Node(Multiset first, Multiset second, const std::vector<unique_ptr<Transition>>& trans,
-             const Transition* delta, const Transition* gamma, int rs_order);
+        Node(ProofTree* tree, Multiset first, Multiset second, const Transition* delta,
+             const Transition* gamma, int rs_order);
+
+        ~Node();
 
         /**
          * Adds a child to the node
          * @param child child to add
          */
-        void AddChild(unique_ptr<Node> child);
+        void AddChild(NodePtr child);
 
         /**
-         * Computes partial ordering for REDUCE
+         * Puts another delta child in the place of a child
+         * @param index position of the replaced child
+         */
+        void ReplaceChild(size_t index, NodePtr child);
+
+        /**
+         * Drops the subtree and the backtracking state of a node whose search was cancelled,
+         * so that it can be searched again from scratch
+         */
+        void Reset();
+
+        /**
+         * Gamma counters of the delta children by transition index, the rs order at 2 * i and
+         * the sr order at 2 * i + 1. Kept inline for small nets, allocated on the first
+         * expansion otherwise, so nodes that are never expanded do not pay for them.
+         * @return array of 2 * transitions counters
+         */
+        int* Counters();
+
+        /**
+         * Splits the pair into its intersection and remainders and updates the path minimum
+         * used to cut the ancestor search short
+         */
+        void ComputeKey();
+
+        /**
+         * Computes partial ordering for REDUCE using the precomputed keys of both nodes
+         * @param other ancestor to compare with
+         * @param reversed compare with the ancestor's pair taken in the (second, first) order
          * @return true if this node is greater than the other, false otherwise
          */
-        bool GreaterThan(Multiset* other_first, Multiset* other_second, Multiset* this_intersect,
-                         Multiset* other_intersect, Multiset* this_first_rem,
-                         Multiset* this_second_rem, Multiset* other_first_rem,
-                         Multiset* other_second_rem) const;
+        bool Dominates(const Node* other, bool reversed) const;
 
+        /**
+         * Levels up to the ancestor assumed by the verdict that closed the node, 0 unless it is
+         * a leaf closed by a scoped verdict
+         */
+        int AssumedUp() const;
+
+        ProofTree* tree;
         Node* parent = nullptr;
         Multiset first, second;
-        std::vector<unique_ptr<Node>> children;
-        std::unordered_map<Transition*, int> rs_used, sr_used;
+        SplitKey key;
+        std::vector<NodePtr> children;
+        static constexpr size_t kInlineCounters = 8;
+        int inline_counters[kInlineCounters] = {};
+        unique_ptr<int[]> heap_counters;
         const Transition* delta_used = nullptr;
         const Transition* gamma_used = nullptr;
         int order_used = 0;  // 1 - rs, 0 - none, -1 - sr
         int id = -1;
         Node* reduced_parent = nullptr;
+        int level = 0;  // distance from the root
+        // Least level of the ancestors whose pairs the subtree assumes bisimilar, through REDUCE
+        // or the transposition table. The verdict of the node holds anywhere if it is not less
+        // than the level of the node.
+        int dependency = INT_MAX;
+        int memo = 0;  // 1 - closed as proven, 0 - none, -1 - closed as refuted
+        bool memo_source = false;  // the node has a scoped entry in the transposition table
+        // The node recorded a proven verdict that holds anywhere, set by certifiable trees only
+        bool recorded = false;
+        bool forked = false;       // the children were searched in parallel by ReduceChildren
+        // The node failed only because a branch below it reached the bound of iterative
+        // deepening, so the failure is not a refutation
+        bool cut_off = false;
+        // Offset of the record of the node in the spill file once its subtree was evicted, -1
+        // while the subtree is in memory
+        int64_t spill_offset = -1;
+        // Position of the node in the order the search finished the nodes, from 1, counted by
+        // certifiable trees only
+        uint64_t finished = 0;
     };
 
     /**
-     * Expand step of the algorithm
+     * Node as passed to the writers, taken from memory or from the spill file
+     */
+    struct NodeView {
+        int id = 0;
+        int parent = -1;   // -1 for the root
+        int reduced = -1;  // id of the ancestor used by REDUCE, -1 if none
+        const int* first = nullptr;
+        const int* second = nullptr;
+        int delta = -1;  // transition index, -1 if the node is not a delta child
+        int gamma = -1;
+        int order = 0;
+        int memo = 0;
+        int level = 0;
+        size_t child_count = 0;
+        bool terminal = false;  // the node has no children
+        bool success = false;   // the pair is an identity or closed as proven
+        bool recorded = false;  // see Node::recorded
+        uint64_t finished = 0;  // see Node::finished
+        // Levels up to the ancestor a leaf closed by a scoped verdict assumes, 0 for other nodes
+        int assumed_up = 0;
+        Node* node = nullptr;   // the node in memory, nullptr if it was read from the spill file
+        uint64_t offset = 0;    // record of the node in the spill file if node is nullptr
+    };
+
+    /**
+     * Slab allocator of nodes. The nodes of a discarded subtree are handed out again to the
+     * subtree built in its place.
+     */
+    class NodePool {
+    public:
+        NodePool() = default;
+
+        NodePool(const NodePool&) = delete;
+        NodePool& operator=(const NodePool&) = delete;
+
+        /**
+         * @return uninitialized memory for a node, reusing released nodes first
+         */
+        void* Allocate();
+
+        /**
+         * @param block memory of a destroyed node, previously obtained from Allocate
+         */
+        void Release(void* block);
+
+        /**
+         * Guards the pool with a mutex, for trees expanded by several threads
+         */
+        void SetConcurrent(bool concurrent);
+
+        /**
+         * @return bytes taken by the slabs of the pool
+         */
+        [[nodiscard]] size_t AllocatedBytes() const;
+
+    private:
+        struct alignas(Node) Block {
+            unsigned char bytes[sizeof(Node)];
+        };
+
+        static constexpr size_t kNodesPerSlab = 256;
+
+        bool concurrent_ = false;
+        std::mutex mutex_;
+        size_t slab_used_ = kNodesPerSlab;
+        std::atomic<size_t> slab_num_{0};
+        std::vector<unique_ptr<Block[]>> slabs_;
+        std::vector<void*> free_nodes_;
+    };
+
+    /**
+     * Transposition table of the pairs decided during the search, the pair taken unordered.
+     *
+     * Verdicts that assume no pair outside of their subtree hold anywhere. Others assume some
+     * ancestor, the scope of the entry, and are only valid below it. They are removed together
+     * with the node that produced them.
+     */
+    class MemoTable {
+    public:
+        explicit MemoTable(MarkingArena* arena);
+
+        void SetConcurrent(bool concurrent);
+
+        /**
+         * Finds a verdict for the pair of the node that is valid at its place in the tree
+         * @param node node to look up
+         * @param proven found verdict
+         * @param scope scope of the found entry, nullptr if it holds anywhere
+         * @return true if a verdict was found, false otherwise
+         */
+        bool Find(const Node* node, bool* proven, const Node** scope) const;
+
+        /**
+         * Records the verdict of the node
+         * @param scope ancestor the verdict assumes, nullptr if it holds anywhere
+         */
+        void Insert(const Node* node, bool proven, const Node* scope);
+
+        /**
+         * Removes the scoped entry produced by the node
+         */
+        void Erase(const Node* source);
+
+        /**
+         * Copies the entries that hold anywhere from the table of a tree over the same net
+         * @return number of copied entries
+         */
+        size_t ImportUnscoped(const MemoTable& other);
+
+        /**
+         * Estimates the memory held by the entries
+         * @return bytes used by the entries besides their markings
+         */
+        [[nodiscard]] size_t MemoryUsage() const;
+
+    private:
+        struct Entry {
+            Multiset first, second;
+            bool proven;
+            const Node* scope;
+            const Node* source;
+        };
+
+        static bool SamePair(const Entry& entry, const Node* node);
+
+        MarkingArena* arena_;
+        bool concurrent_ = false;
+        mutable std::mutex mutex_;
+        std::unordered_multimap<uint64_t, Entry> entries_;
+        std::atomic<size_t> size_{0};
+    };
+
+    /**
+     * Antichain of the pairs refuted anywhere in the tree, by their remainders.
+     *
+     * Resource bisimilarity is closed under adding the same resource to both sides, so a pair
+     * that is not bisimilar stays so with any common part taken away. A refuted pair thus covers
+     * every pair with the same remainders and a smaller intersection, and only the refuted pairs
+     * with the largest intersections are kept for each pair of remainders.
+     */
+    class RefutedPairs {
+    public:
+        explicit RefutedPairs(MarkingArena* arena);
+
+        void SetConcurrent(bool concurrent);
+
+        /**
+         * @param node node whose key is computed
+         * @return true if a refuted pair covers the node in either order of its pair
+         */
+        bool Covers(const Node* node) const;
+
+        /**
+         * Adds the refuted node unless it is covered, removing the pairs it covers
+         * @param node node whose key is computed
+         */
+        void Insert(const Node* node);
+
+        /**
+         * Copies the pairs of a tree over the same net
+         * @return number of copied pairs
+         */
+        size_t Import(const RefutedPairs& other);
+
+        [[nodiscard]] size_t MemoryUsage() const;
+
+    private:
+        struct Entry {
+            Multiset first_rem, second_rem, intersect;
+            uint64_t intersect_mask;
+        };
+
+        /**
+         * @return true if the entry has the remainders of the node, in the order of its pair
+         * if reversed is false
+         */
+        static bool SameRemainders(const Entry& entry, const Node* node, bool reversed);
+
+        bool CoversLocked(const Node* node, uint64_t hash) const;
+
+        MarkingArena* arena_;
+        bool concurrent_ = false;
+        mutable std::mutex mutex_;
+        std::unordered_multimap<uint64_t, Entry> entries_;
+        std::atomic<size_t> size_{0};
+    };
+
+    /**
+     * Antichain approximating the basis, built node by node in the order of TreeTraversal
+     *
+     * Elements are kept sorted by the total power of their pairs. An element can only be greater
+     * than pairs of no larger power, so each update compares the node with the elements on one
+     * side of its power only, using the precomputed REDUCE keys with their support masks.
+     * Identical pairs are only ever comparable with each other and are kept apart.
+     */
+    class BasisIndex {
+    public:
+        /**
+         * Adds the node unless an element is below it, removing the elements above it first
+         * @param node node whose key is computed if its pair is not identical
+         */
+        void Update(Node* node);
+
+        /**
+         * @return the non-identical pairs of the basis, by increasing power
+         */
+        [[nodiscard]] std::vector<const Node*> Pairs() const;
+
+        void Clear();
+
+    private:
+        using Elements = std::multimap<uint64_t, Node*>;
+
+        /**
+         * @return true if the element is greater than the node in either order of its pair
+         */
+        static bool Covers(const Node* element, const Node* node, bool identity);
+
+        /**
+         * @return true if the node is greater than the element in the order of its pair
+         */
+        static bool Below(const Node* element, const Node* node, bool identity);
+
+        Elements pairs_, identities_;
+    };
+
+    /**
+     * Gamma choices of a previous tree by the ordered pair of the expanded node, read-only
+     * during the search
+     */
+    class GammaHints {
+    public:
+        explicit GammaHints(size_t place_num);
+
+        /**
+         * @param offsets position of the chosen gamma among the candidates of every delta,
+         * indexed like the gamma counters
+         */
+        void Insert(const Multiset& first, const Multiset& second, std::vector<int> offsets);
+
+        /**
+         * @return offsets of the pair, nullptr if it was not expanded
+         */
+        [[nodiscard]] const int* Find(const Multiset& first, const Multiset& second) const;
+
+    private:
+        struct Entry {
+            Multiset first, second;
+            std::vector<int> offsets;
+        };
+
+        MarkingArena arena_;
+        std::unordered_multimap<uint64_t, Entry> entries_;
+    };
+
+    /**
+     * Node whose children are being reduced, kept on the explicit stack of Expand
+     */
+    struct ExpandFrame {
+        Node* node;
+        int depth;
+        size_t next_child;  // position in order
+        std::vector<uint32_t> order;  // indexes of the children by position, empty if in order
+        size_t backtracks = 0;
+        bool child_cut = false;  // a choice of the current child was cut off by the bound
+        bool cut_skipped = false;  // some child ran out of choices only under the bound
+        // Set when the subtree is traced
+        std::chrono::steady_clock::time_point start{};
+        size_t start_nodes = 0;
+    };
+
+    /**
+     * Pushes the frame of a node whose children were generated, starting its trace span
+     */
+    void PushFrame(std::vector<ExpandFrame>* stack, Node* node, int depth);
+
+    /**
+     * Pops the frame of a finished node, recording its trace span
+     */
+    void PopFrame(std::vector<ExpandFrame>* stack, bool proven);
+
+    /**
+     * Expands the root, in passes of growing depth bound with iterative deepening
+     * @param token cancellation of the search, nullptr in sequential mode
+     * @return bisimilarity of the root, false if the search was interrupted
+     */
+    bool Search(const CancellationToken* token);
+
+    /**
+     * Orders the delta children of the node by the strategy
+     * @return indexes of the children in the order to search them, empty for their own order
+     */
+    std::vector<uint32_t> VisitOrder(const Node* node) const;
+
+    /**
+     * @return transitions that can mirror delta, in the order they are tried
+     */
+    Span<const Transition*> Candidates(const Transition* delta) const;
+
+    /**
+     * Expand step of the algorithm, run over the whole subtree with an explicit stack. The
+     * children are searched in the order of the strategy, and like in ReduceChildren a child cut
+     * off by the deepening bound does not stop the search of the others.
      * @param node node to perform the step on
-     * @param depth depth of recursion
-     * @return bisimilarity for the resulting subtree
+     * @param depth number of EXPAND steps above the node
+     * @param token cancellation of the subtree, nullptr in sequential mode
+     * @return bisimilarity for the resulting subtree, false if the search was interrupted
+     */
+    bool Expand(Node* node, int depth, const CancellationToken* token);
+
+    /**
+     * Builds the delta children of the node with their first gamma choices
+     * @param node node to build the children for
+     * @param depth number of EXPAND steps above the node
+     * @param token cancellation of the subtree, nullptr in sequential mode
+     * @return false if some transition cannot be mirrored or the search was interrupted
      */
-    bool Expand(Node* node, int depth);
+    bool GenerateChildren(Node* node, int depth, const CancellationToken* token);
 
     /**
-     * Reduce step of the algorithm
+     * Reduce step of the algorithm, repeated while some ancestor is smaller than the node
      * @param node node to perform the step on
-     * @param depth depth of recursion
-     * @return bisimilarity for the resulting subtree
+     * @return the last node of the chain of REDUCE children, to be expanded
+     */
+    Node* Reduce(Node* node);
+
+    /**
+     * Replaces a failed delta child of the node with the next gamma choice of its delta
+     * @param node node whose child failed
+     * @param index position of the child, 2 * i for the rs order and 2 * i + 1 for sr
+     * @param token cancellation of the subtree, nullptr in sequential mode
+     * @return false if no gamma choice is left or the search was interrupted
+     */
+    bool NextChoice(Node* node, size_t index, const CancellationToken* token);
+
+    /**
+     * Reduces and expands every child of the node in parallel. A failing child is replaced by
+     * its next gamma choice in the same task, and a child out of choices cancels the remaining
+     * ones. With iterative deepening a child out of choices only under the bound is left failed
+     * while the others go on, as one of them may still refute the node.
+     * @param node node whose children to reduce
+     * @param depth number of EXPAND steps above the node
+     * @param token cancellation of the subtree
+     * @return true if all children are bisimilar, false otherwise
+     */
+    bool ReduceChildren(Node* node, int depth, const CancellationToken* token);
+
+    /**
+     * Closes the node without expanding it if its pair is an identity or already decided
+     * @param proven outcome of the closed node
+     * @return true if the node was closed, false if it has to be expanded
+     */
+    bool Settle(Node* node, bool* proven);
+
+    /**
+     * Records the outcome of a finished node and of the REDUCE chain leading to it from the
+     * children of stop, passing their dependencies up the chain
+     * @param node finished node
+     * @param stop node whose child starts the chain, its dependency is left to the caller
+     * @param proven outcome of the node
+     * @param token cancellation of the subtree, failures after cancellation are not recorded
+     * @return child of stop starting the chain
+     */
+    Node* Complete(Node* node, const Node* stop, bool proven, const CancellationToken* token);
+
+    /**
+     * Checks the cancellation token and the search limits, remembering if a limit ran out
+     * @return true if the search has to stop
+     */
+    bool Interrupted(const CancellationToken* token);
+
+    /**
+     * Calls the progress callback if the interval has passed since the previous call
+     * @param depth depth of the node being expanded
+     */
+    void ReportProgress(int depth);
+
+    /**
+     * Estimates the memory held by the tree
+     * @return bytes used by the markings and the nodes
+     */
+    size_t MemoryUsage() const;
+
+    void UpdatePeakMemory();
+
+    NodePtr MakeNode(Multiset first, Multiset second, const Transition* delta,
+                     const Transition* gamma, int rs_order);
+
+    /**
+     * Destroys the node and its subtree without recursion and returns them to the node pool
+     */
+    void ReleaseSubtree(Node* node);
+
+    /**
+     * Keeps the subtree of a node that recorded a verdict apart from the tree, dropping the
+     * scoped entries of its nodes, which no node of the tree can use any more
+     * @param node node detached from its parent
+     */
+    void KeepSubtree(Node* node);
+
+    /**
+     * Traverses the tree using Depth-First Search, recording a basis, if required. Evicted
+     * subtrees are read back from the spill file.
+     * @param visit callback for every node, called after the callback for its parent, with ids
+     * numbered in the order of the calls
+     * @param finish_order visit the children of a node in the order they were finished, see
+     * Node::finished; the last child first otherwise
+     */
+    void TreeTraversal(const std::function<void(const NodeView&)>& visit,
+                       bool finish_order = false);
+
+    /**
+     * Traverses the subtree of a node like TreeTraversal, with the ids and levels counted from
+     * it and without the basis. The node may be a subtree kept apart from the tree.
+     * @param start node in memory, nullptr to start from a record of the spill file
+     * @param start_offset record to start from if start is nullptr
      */
-    bool Reduce(Node* node, int depth);
+    void SubtreeTraversal(Node* start, uint64_t start_offset,
+                          const std::function<void(const NodeView&)>& visit, bool finish_order);
 
     /**
-     * Traverses the tree using Depth-First Search, recording nodes, edges and a basis, if required
-     * @param nodes nodes to collect
-     * @param edges edges to collect
+     * Writes the subtree of a complete node to the spill file and releases its descendants,
+     * leaving the node as the root of the evicted subtree
      */
-    void TreeTraversal(std::vector<Node*>* nodes, std::vector<std::pair<Node*, Node*>>* edges);
+    void Spill(Node* node);
 
     /**
      * Finds a random delta0child of node (first, second)
      * @param delta transition
      * @param first left state of the node
      * @param second right state of the node
+     * @param counter number of candidates already tried
+     * @param offset candidate to start from, the candidates are tried cyclically
      * @return nullptr if the set of children is empty, the child node otherwise
      */
-    unique_ptr<Node> DeltaChild(const Transition* delta, const Multiset* first,
-                                const Multiset* second, int* counter, int rs_order);
+    NodePtr DeltaChild(const Transition* delta, const Multiset* first, const Multiset* second,
+                       int* counter, int rs_order, int offset);
 
-    unique_ptr<Node> root_;
+    // Declared before the root so that they outlive every node
+    MarkingArena arena_;
+    NodePool node_pool_;
+    std::atomic<size_t> nodes_created_{0};
+    std::atomic<size_t> counter_bytes_{0}, peak_memory_{0};
+    MemoTable memo_;
+    RefutedPairs refuted_;
+    NodePtr root_;
+    // Subtrees discarded by the search but kept for the certificate, see SetCertifiable
+    std::vector<NodePtr> kept_;
+    std::mutex kept_mutex_;
+    bool certifiable_ = false;
+    std::atomic<uint64_t> finished_count_{0};
     bool record_basis_ = false;
-    std::unordered_set<Node*> basis_;
+    BasisIndex basis_;
+    bool basis_ready_ = false;  // the basis of the finished tree was computed
     PetriNet* petri_net_;
+    unique_ptr<ThreadPool> pool_;  // nullptr in sequential mode
+    SearchLimits limits_;
+    SearchStrategy strategy_;
+    int depth_bound_ = 0;  // bound of the current pass of iterative deepening, 0 if none
+    size_t deepening_passes_ = 0;
+    // Gamma candidates of every transition in the order of the strategy, starting at the offset
+    // of its index; empty for the order of the net
+    std::vector<const Transition*> gamma_order_;
+    std::vector<size_t> gamma_offsets_;
+    std::chrono::steady_clock::time_point start_time_;
+    std::atomic<bool> limit_exceeded_{false};
+    const CancellationToken* cancellation_ = nullptr;
+    std::function<void(const SearchProgress&)> progress_callback_;
+    std::chrono::steady_clock::duration progress_interval_{};
+    std::atomic<std::chrono::steady_clock::rep> next_report_{0};  // ticks since start_time_
+    std::mutex progress_mutex_;
+    bool memoize_ = true;
+    SharedMemo* shared_memo_ = nullptr;
+    std::atomic<size_t> memo_hits_{0}, memo_misses_{0}, refuted_hits_{0};
+    unique_ptr<SearchProfiler> profiler_;  // nullptr unless profiling
+    std::chrono::steady_clock::duration elapsed_{};
+    unique_ptr<GammaHints> hints_;  // nullptr unless reusing a previous tree
+    size_t reused_pairs_ = 0;
+    std::atomic<size_t> hinted_nodes_{0};
+    unique_ptr<SpillFile> spill_;  // nullptr unless spilling
+    std::atomic<size_t> spilled_nodes_{0};
+    Verdict verdict_ = Verdict::kUnknown;
     bool success = false;
 };
@@ -0,0 +1,82 @@
+#include "spillfile.h"
+#include <stdexcept>
+
+namespace {
+
+/**
+ * Moves the position of the file, with 64-bit offsets on every platform
+ */
+int Seek(std::FILE* file, uint64_t offset, int origin) {
+#ifdef _WIN32
+    return _fseeki64(file, static_cast<int64_t>(offset), origin);
+#else
+    return fseeko(file, static_cast<off_t>(offset), origin);
+#endif
+}
+
+}  // namespace
+
+SpillFile::SpillFile(std::string path, size_t place_num)
+    : path_(std::move(path)), place_num_(place_num) {
+    file_ = std::fopen(path_.c_str(), "w+b");
+    if (file_ == nullptr) {
+        throw std::runtime_error("Cannot create " + path_);
+    }
+}
+
+SpillFile::~SpillFile() {
+    std::fclose(file_);
+    std::remove(path_.c_str());
+}
+
+uint64_t SpillFile::Append(const RecordHeader& header, const int* first, const int* second,
+                           const uint64_t* children) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (reading_) {
+        Seek(file_, 0, SEEK_END);
+        reading_ = false;
+    }
+    uint64_t offset = size_;
+    WriteRaw(&header, sizeof(header));
+    WriteRaw(first, place_num_ * sizeof(int));
+    WriteRaw(second, place_num_ * sizeof(int));
+    WriteRaw(children, header.child_count * sizeof(uint64_t));
+    return offset;
+}
+
+void SpillFile::Read(uint64_t offset, Record* record) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!reading_) {
+        // Buffered writes have to reach the file before it is read
+        std::fflush(file_);
+        reading_ = true;
+    }
+    if (offset >= size_ || Seek(file_, offset, SEEK_SET) != 0) {
+        throw std::runtime_error("Cannot read " + path_);
+    }
+    ReadRaw(&record->header, sizeof(record->header));
+    record->first.resize(place_num_);
+    record->second.resize(place_num_);
+    record->children.resize(record->header.child_count);
+    ReadRaw(record->first.data(), place_num_ * sizeof(int));
+    ReadRaw(record->second.data(), place_num_ * sizeof(int));
+    ReadRaw(record->children.data(), record->children.size() * sizeof(uint64_t));
+}
+
+uint64_t SpillFile::Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_;
+}
+
+void SpillFile::WriteRaw(const void* data, size_t size) {
+    if (size > 0 && std::fwrite(data, 1, size, file_) != size) {
+        throw std::runtime_error("Cannot write " + path_);
+    }
+    size_ += size;
+}
+
+void SpillFile::ReadRaw(void* data, size_t size) {
+    if (size > 0 && std::fread(data, 1, size, file_) != size) {
+        throw std::runtime_error("Cannot read " + path_);
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Append-only scratch file holding the proven subtrees evicted from a proof tree
+ *
+ * Every node is one record, written after the records of its children so that it can refer to
+ * them by offset:
+ *   header | first marking | second marking | child offsets
+ * with the markings as 32-bit integers and the offsets as 64-bit integers, in the byte order of
+ * the machine. The file only lives as long as the tree that wrote it.
+ */
+class SpillFile {
+public:
+    struct RecordHeader {
+        int32_t delta;        // transition index, -1 if the node is not a delta child
+        int32_t gamma;
+        int32_t reduced_up;   // levels up to the ancestor used by REDUCE, 0 if none
+        uint32_t child_count;
+        int8_t order;         // 1 - rs, 0 - none, -1 - sr
+        int8_t memo;          // 1 - closed as proven, 0 - none, -1 - closed as refuted
+        uint8_t recorded;     // see ProofTree::Node::recorded
+        uint8_t reserved;
+        int32_t assumed_up;   // see ProofTree::NodeView::assumed_up
+        uint64_t finished;    // see ProofTree::Node::finished
+    };
+
+    /**
+     * Node decoded from the file, reused between reads to keep its buffers
+     */
+    struct Record {
+        RecordHeader header{};
+        std::vector<int> first, second;
+        std::vector<uint64_t> children;
+    };
+
+    /**
+     * Creates the file, replacing any file at the path
+     * @param path path to the file
+     * @param place_num number of places of every marking
+     * @throws std::runtime_error if the file cannot be created
+     */
+    SpillFile(std::string path, size_t place_num);
+
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+
+    /**
+     * Closes and removes the file
+     */
+    ~SpillFile();
+
+    /**
+     * Appends a record, safe to call from several threads
+     * @param first marking of place_num values
+     * @param children offsets of the records of the children, in order
+     * @return offset of the record
+     * @throws std::runtime_error if the write fails
+     */
+    uint64_t Append(const RecordHeader& header, const int* first, const int* second,
+                    const uint64_t* children);
+
+    /**
+     * Reads back a record
+     * @param offset offset returned by Append
+     * @throws std::runtime_error if the read fails
+     */
+    void Read(uint64_t offset, Record* record);
+
+    /**
+     * @return bytes written so far
+     */
+    [[nodiscard]] uint64_t Size() const;
+
+private:
+    void WriteRaw(const void* data, size_t size);
+
+    void ReadRaw(void* data, size_t size);
+
+    std::string path_;
+    size_t place_num_;
+    std::FILE* file_ = nullptr;
+    mutable std::mutex mutex_;
+    uint64_t size_ = 0;
+    bool reading_ = false;  // the position was moved by a read and has to go back to the end
+};
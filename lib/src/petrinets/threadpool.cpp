@@ -0,0 +1,184 @@
+#include "threadpool.h"
+
+namespace {
+
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_index = 0;
+
+}  // namespace
+
+CancellationToken::CancellationToken(const CancellationToken* parent) : parent_(parent) {
+}
+
+void CancellationToken::Cancel() {
+    cancelled_.store(true, std::memory_order_relaxed);
+}
+
+bool CancellationToken::IsCancelled() const {
+    for (auto token = this; token != nullptr; token = token->parent_) {
+        if (token->cancelled_.load(std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ThreadPool::ThreadPool(size_t worker_num) : idle_(worker_num) {
+    for (size_t i = 0; i <= worker_num; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i < worker_num; ++i) {
+        workers_.emplace_back([this, i] { WorkerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto&& worker : workers_) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::CurrentQueue() const {
+    return current_pool == this ? current_index : queues_.size() - 1;
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+    Queue& queue = *queues_[CurrentQueue()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        ++queued_;
+    }
+    wake_.notify_one();
+}
+
+std::function<void()> ThreadPool::Take() {
+    size_t self = CurrentQueue();
+    std::function<void()> task;
+    for (size_t i = 0; i < queues_.size() && !task; ++i) {
+        size_t index = (self + i) % queues_.size();
+        Queue& queue = *queues_[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        // Own tasks are taken LIFO for locality, stolen ones FIFO as they are the largest
+        if (index == self) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+    if (task) {
+        --queued_;
+    }
+    return task;
+}
+
+bool ThreadPool::RunPending() {
+    auto task = Take();
+    if (!task) {
+        return false;
+    }
+    task();
+    return true;
+}
+
+void ThreadPool::RunUntil(const std::function<bool()>& done) {
+    while (!done()) {
+        if (RunPending()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        ++idle_;
+        wake_.wait(lock, [&] { return queued_ > 0 || done(); });
+        --idle_;
+    }
+}
+
+void ThreadPool::Notify() {
+    // Taking the mutex orders the change of the condition before the sleepers test it
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+    }
+    wake_.notify_all();
+}
+
+bool ThreadPool::HasIdleThread() const {
+    return idle_ > queued_;
+}
+
+void ThreadPool::WorkerLoop(size_t index) {
+    current_pool = this;
+    current_index = index;
+    // Workers count as idle from the start, so that the first forks do not wait for them
+    while (true) {
+        if (auto task = Take()) {
+            --idle_;
+            task();
+            ++idle_;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        wake_.wait(lock, [this] { return stop_ || queued_ > 0; });
+        if (stop_) {
+            return;
+        }
+    }
+}
+
+TaskGroup::TaskGroup(ThreadPool* pool, CancellationToken* cancel) : pool_(pool), cancel_(cancel) {
+}
+
+TaskGroup::~TaskGroup() {
+    if (pending_ > 0) {
+        // Left by an exception, the tasks may refer to the frames being unwound
+        if (cancel_ != nullptr) {
+            cancel_->Cancel();
+        }
+        Join();
+    }
+}
+
+void TaskGroup::Run(std::function<void()> task) {
+    ++pending_;
+    pool_->Submit([this, pool = pool_, task = std::move(task)] {
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+            if (cancel_ != nullptr) {
+                cancel_->Cancel();
+            }
+        }
+        // The group may be gone as soon as the count drops, the pool outlives it
+        --pending_;
+        pool->Notify();
+    });
+}
+
+void TaskGroup::Join() {
+    pool_->RunUntil([this] { return pending_ == 0; });
+}
+
+void TaskGroup::Wait() {
+    Join();
+    if (error_) {
+        std::exception_ptr error = error_;
+        error_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Cooperative cancellation flag, cancelled as well when any of its parents is
+ */
+class CancellationToken {
+public:
+    explicit CancellationToken(const CancellationToken* parent = nullptr);
+
+    void Cancel();
+
+    [[nodiscard]] bool IsCancelled() const;
+
+private:
+    std::atomic<bool> cancelled_{false};
+    const CancellationToken* parent_;
+};
+
+/**
+ * Work-stealing thread pool for fork-join tasks
+ *
+ * Every worker owns a deque: it pushes and pops its own tasks from the back and steals from the
+ * front of the others. Threads outside the pool share one extra deque.
+ */
+class ThreadPool {
+public:
+    /**
+     * Creates the pool
+     * @param worker_num number of worker threads, the waiting thread helps as well
+     */
+    explicit ThreadPool(size_t worker_num);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool();
+
+    void Submit(std::function<void()> task);
+
+    /**
+     * Runs one queued task on the calling thread, preferring its own deque
+     * @return true if a task was run, false if all deques were empty
+     */
+    bool RunPending();
+
+    /**
+     * Runs queued tasks on the calling thread, sleeping while there are none, until a condition
+     * holds. The condition is tested again on every Notify.
+     * @param done condition to wait for
+     */
+    void RunUntil(const std::function<bool()>& done);
+
+    /**
+     * Wakes the threads sleeping in RunUntil to test their conditions
+     */
+    void Notify();
+
+    /**
+     * @return true if more threads wait for work than there are queued tasks, so that a forked
+     * task would start at once
+     */
+    [[nodiscard]] bool HasIdleThread() const;
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void WorkerLoop(size_t index);
+
+    size_t CurrentQueue() const;
+
+    /**
+     * Takes one queued task, preferring the deque of the calling thread
+     * @return the task, empty if all deques were empty
+     */
+    std::function<void()> Take();
+
+    std::vector<std::unique_ptr<Queue>> queues_;  // the last one is for external threads
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> queued_{0};
+    std::atomic<size_t> idle_{0};  // workers not running a task and threads sleeping in RunUntil
+    std::atomic<bool> stop_{false};
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+};
+
+/**
+ * Set of tasks forked from one thread that is joined with Wait
+ *
+ * An exception thrown by a task cancels the group and is rethrown by Wait. A group destroyed with
+ * tasks still running cancels and joins them.
+ */
+class TaskGroup {
+public:
+    /**
+     * @param cancel token cancelled when a task throws, nullptr if the tasks take none
+     */
+    explicit TaskGroup(ThreadPool* pool, CancellationToken* cancel = nullptr);
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    ~TaskGroup();
+
+    void Run(std::function<void()> task);
+
+    /**
+     * Helps with queued tasks until every task of the group has finished
+     * @throws the first exception thrown by a task of the group
+     */
+    void Wait();
+
+private:
+    void Join();
+
+    ThreadPool* pool_;
+    CancellationToken* cancel_;
+    std::atomic<size_t> pending_{0};
+    std::mutex error_mutex_;
+    std::exception_ptr error_;
+};
@@ -0,0 +1,328 @@
+#include "treefile.h"
+#include <cstring>
+#include <stdexcept>
+#include "graphml.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The binary proof tree format is written in the native byte order, which must be little-endian"
+#endif
+
+namespace treefile {
+
+uint8_t MarkingBytes(int max_value) {
+    if (max_value <= UINT8_MAX) {
+        return 1;
+    }
+    if (max_value <= UINT16_MAX) {
+        return 2;
+    }
+    return 4;
+}
+
+void PackMarking(const int* marking, size_t place_num, uint8_t marking_bytes, char* out) {
+    for (size_t i = 0; i < place_num; ++i) {
+        if (marking_bytes == 1) {
+            out[i] = static_cast<char>(static_cast<uint8_t>(marking[i]));
+        } else if (marking_bytes == 2) {
+            auto value = static_cast<uint16_t>(marking[i]);
+            std::memcpy(out + 2 * i, &value, sizeof(value));
+        } else {
+            auto value = static_cast<int32_t>(marking[i]);
+            std::memcpy(out + 4 * i, &value, sizeof(value));
+        }
+    }
+}
+
+}  // namespace treefile
+
+namespace {
+
+/**
+ * Reads a value from a possibly unaligned position of the mapping
+ */
+template <class T>
+T Load(const char* data) {
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+}  // namespace
+
+TreeFile::TreeFile(const std::string& path) {
+    Map(path);
+    try {
+        if (size_ < sizeof(treefile::Header)) {
+            throw std::runtime_error(path + " is not a proof tree file");
+        }
+        header_ = Load<treefile::Header>(data_);
+        if (std::memcmp(header_.magic, treefile::kMagic, sizeof(treefile::kMagic)) != 0) {
+            throw std::runtime_error(path + " is not a proof tree file");
+        }
+        if (header_.version != treefile::kVersion) {
+            throw std::runtime_error(path + " has an unsupported proof tree format version");
+        }
+        uint8_t bytes = header_.marking_bytes;
+        if (bytes != 1 && bytes != 2 && bytes != 4) {
+            throw std::runtime_error(path + " is corrupted");
+        }
+        size_t pair_bytes = 2 * size_t{header_.place_num} * bytes;
+        node_stride_ = (sizeof(treefile::NodeRecord) + pair_bytes + 7) / 8 * 8;
+        if (header_.nodes_offset > size_ ||
+            header_.node_count > (size_ - header_.nodes_offset) / node_stride_ ||
+            header_.basis_offset + header_.basis_count * pair_bytes > size_) {
+            throw std::runtime_error(path + " is truncated");
+        }
+
+        const char* position = data_ + header_.transitions_offset;
+        const char* end = data_ + header_.nodes_offset;
+        auto read_string = [&](std::string* out) {
+            if (end - position < static_cast<ptrdiff_t>(sizeof(uint32_t))) {
+                throw std::runtime_error(path + " is corrupted");
+            }
+            auto length = Load<uint32_t>(position);
+            position += sizeof(uint32_t);
+            if (end - position < static_cast<ptrdiff_t>(length)) {
+                throw std::runtime_error(path + " is corrupted");
+            }
+            out->assign(position, length);
+            position += length;
+        };
+        transitions_.resize(header_.transition_count);
+        for (auto&& transition : transitions_) {
+            read_string(&transition.id);
+            read_string(&transition.label);
+            if (end - position <
+                static_cast<ptrdiff_t>(header_.place_num * sizeof(int32_t))) {
+                throw std::runtime_error(path + " is corrupted");
+            }
+            transition.change.resize(header_.place_num);
+            for (auto&& change : transition.change) {
+                change = Load<int32_t>(position);
+                position += sizeof(int32_t);
+            }
+        }
+    } catch (...) {
+        Unmap();
+        throw;
+    }
+}
+
+TreeFile::~TreeFile() {
+    Unmap();
+}
+
+uint64_t TreeFile::NodeCount() const {
+    return header_.node_count;
+}
+
+size_t TreeFile::PlaceNum() const {
+    return header_.place_num;
+}
+
+int TreeFile::Verdict() const {
+    return header_.verdict;
+}
+
+bool TreeFile::HasBasis() const {
+    return header_.has_basis != 0;
+}
+
+const std::vector<TreeFile::TransitionInfo>& TreeFile::Transitions() const {
+    return transitions_;
+}
+
+TreeFile::Node TreeFile::GetNode(uint64_t id) const {
+    const auto& record = Record(id);
+    Node node;
+    node.id = id;
+    node.parent = record.parent;
+    node.reduced = record.reduced;
+    node.first_child = record.first_child;
+    node.child_count = record.child_count;
+    node.delta = record.delta;
+    node.gamma = record.gamma;
+    node.order = record.order;
+    node.memo = record.memo;
+    node.terminal = record.terminal == 0 ? "NOT" : record.terminal == 1 ? "SUCCESS" : "FAIL";
+    const char* packed = reinterpret_cast<const char*>(&record) + sizeof(treefile::NodeRecord);
+    node.first = UnpackMarking(packed);
+    node.second = UnpackMarking(packed + header_.place_num * header_.marking_bytes);
+    return node;
+}
+
+std::vector<std::pair<std::vector<int>, std::vector<int>>> TreeFile::Basis() const {
+    std::vector<std::pair<std::vector<int>, std::vector<int>>> basis;
+    size_t marking_size = size_t{header_.place_num} * header_.marking_bytes;
+    const char* packed = data_ + header_.basis_offset;
+    for (uint64_t i = 0; i < header_.basis_count; ++i, packed += 2 * marking_size) {
+        basis.emplace_back(UnpackMarking(packed), UnpackMarking(packed + marking_size));
+    }
+    return basis;
+}
+
+void TreeFile::WriteGraphML(const std::string& path) const {
+    std::vector<std::string> descriptions;
+    for (auto&& transition : transitions_) {
+        std::string text = transition.id + ", " + transition.label + ", [";
+        for (size_t i = 0; i < transition.change.size(); ++i) {
+            if (i != 0) {
+                text += ", ";
+            }
+            text += std::to_string(transition.change[i]);
+        }
+        descriptions.push_back(text + ']');
+    }
+    GraphMLWriter writer(path, header_.place_num, std::move(descriptions));
+    if (header_.node_count == 0) {
+        writer.EndGraph();
+        writer.Close();
+        return;
+    }
+
+    // Same preorder as ProofTree::TreeTraversal, which numbers the nodes of PrintTree
+    std::vector<uint64_t> dfs_ids(header_.node_count, treefile::kNone);
+    std::vector<uint64_t> stack{0};
+    uint64_t next_id = 0;
+    while (!stack.empty()) {
+        uint64_t current = stack.back();
+        stack.pop_back();
+        dfs_ids[current] = next_id++;
+        Node node = GetNode(current);
+        GraphMLNode out;
+        out.id = dfs_ids[current];
+        out.first = node.first.data();
+        out.second = node.second.data();
+        out.order = node.order;
+        out.delta = node.delta;
+        out.gamma = node.gamma;
+        if (node.reduced != treefile::kNone) {
+            out.reduced = static_cast<int64_t>(dfs_ids[node.reduced]);
+        }
+        out.memo = node.memo;
+        out.terminal = node.child_count == 0;
+        out.success = node.terminal == "SUCCESS";
+        writer.WriteNode(out);
+        if (node.parent != treefile::kNone) {
+            writer.WriteEdge(dfs_ids[node.parent], out.id);
+        }
+        for (uint32_t i = 0; i < node.child_count; ++i) {
+            stack.push_back(node.first_child + i);
+        }
+    }
+    writer.EndGraph();
+    if (HasBasis()) {
+        writer.BeginBasis();
+        for (auto&& [first, second] : Basis()) {
+            writer.WriteBasisPair(first.data(), second.data());
+        }
+    }
+    writer.Close();
+}
+
+const treefile::NodeRecord& TreeFile::Record(uint64_t id) const {
+    if (id >= header_.node_count) {
+        throw std::out_of_range("No node " + std::to_string(id) + " in the proof tree");
+    }
+    return *reinterpret_cast<const treefile::NodeRecord*>(data_ + header_.nodes_offset +
+                                                          id * node_stride_);
+}
+
+std::vector<int> TreeFile::UnpackMarking(const char* packed) const {
+    std::vector<int> marking(header_.place_num);
+    for (size_t i = 0; i < marking.size(); ++i) {
+        if (header_.marking_bytes == 1) {
+            marking[i] = static_cast<uint8_t>(packed[i]);
+        } else if (header_.marking_bytes == 2) {
+            marking[i] = Load<uint16_t>(packed + 2 * i);
+        } else {
+            marking[i] = Load<int32_t>(packed + 4 * i);
+        }
+    }
+    return marking;
+}
+
+#ifdef _WIN32
+
+void TreeFile::Map(const std::string& path) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        throw std::runtime_error("Cannot read " + path);
+    }
+    size_ = static_cast<size_t>(size.QuadPart);
+    if (size_ == 0) {
+        CloseHandle(file);
+        throw std::runtime_error(path + " is not a proof tree file");
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        throw std::runtime_error("Cannot map " + path);
+    }
+    data_ = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (data_ == nullptr) {
+        CloseHandle(mapping);
+        throw std::runtime_error("Cannot map " + path);
+    }
+    mapping_ = mapping;
+}
+
+void TreeFile::Unmap() {
+    if (data_ != nullptr) {
+        UnmapViewOfFile(data_);
+        CloseHandle(static_cast<HANDLE>(mapping_));
+        data_ = nullptr;
+        mapping_ = nullptr;
+    }
+}
+
+#else
+
+void TreeFile::Map(const std::string& path) {
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    struct stat info {};
+    if (fstat(file, &info) != 0) {
+        close(file);
+        throw std::runtime_error("Cannot read " + path);
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    if (size_ == 0) {
+        close(file);
+        throw std::runtime_error(path + " is not a proof tree file");
+    }
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("Cannot map " + path);
+    }
+    data_ = static_cast<const char*>(data);
+}
+
+void TreeFile::Unmap() {
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+        data_ = nullptr;
+    }
+}
+
+#endif
@@ -0,0 +1,149 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Binary proof tree format
+ *
+ * The file is laid out to be memory mapped, all numbers little-endian:
+ *   header | transitions | nodes | basis
+ *
+ * Nodes are numbered in BFS order, so the children of a node form the range
+ * [first_child, first_child + child_count). Every node record is followed by the markings of its
+ * pair, each place packed into marking_bytes bytes, which gives all nodes the same stride. A
+ * transition is its id and label, each a 32-bit length and the bytes, followed by the change it
+ * makes to every place as 32-bit integers. Basis pairs are packed like the node markings.
+ */
+namespace treefile {
+
+constexpr char kMagic[8] = {'P', 'N', 'T', 'R', 'E', 'E', '\r', '\n'};
+constexpr uint32_t kVersion = 1;
+
+enum VerdictCode : uint8_t { kNotBisimilar = 0, kBisimilar = 1, kUnknown = 2 };
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t place_num;
+    uint64_t node_count;
+    uint32_t transition_count;
+    uint8_t marking_bytes;  // 1, 2 or 4
+    uint8_t verdict;        // VerdictCode
+    uint8_t has_basis;
+    uint8_t reserved;
+    uint64_t transitions_offset;
+    uint64_t nodes_offset;
+    uint64_t basis_offset;
+    uint64_t basis_count;
+};
+
+struct NodeRecord {
+    uint64_t parent;       // kNone for the root
+    uint64_t reduced;      // ancestor used by REDUCE, kNone if none
+    uint64_t first_child;
+    uint32_t child_count;
+    int32_t delta;         // transition index, -1 if the node is not a delta child
+    int32_t gamma;
+    int8_t order;          // 1 - rs, 0 - none, -1 - sr
+    int8_t memo;           // 1 - closed as proven, 0 - none, -1 - closed as refuted
+    uint8_t terminal;      // 0 - inner node, 1 - success, 2 - failure
+    uint8_t reserved;
+};
+
+constexpr uint64_t kNone = UINT64_MAX;
+
+static_assert(sizeof(Header) == 64, "The header layout is part of the format");
+static_assert(sizeof(NodeRecord) == 40, "The node layout is part of the format");
+
+/**
+ * Chooses the smallest packing that holds every marking value
+ * @param max_value largest value of a marking
+ * @return 1, 2 or 4 bytes per place
+ */
+uint8_t MarkingBytes(int max_value);
+
+/**
+ * Packs a marking into marking_bytes bytes per place
+ */
+void PackMarking(const int* marking, size_t place_num, uint8_t marking_bytes, char* out);
+
+}  // namespace treefile
+
+/**
+ * Memory-mapped binary proof tree, decoding nodes on demand
+ */
+class TreeFile {
+public:
+    struct Node {
+        uint64_t id;
+        uint64_t parent;  // treefile::kNone for the root
+        uint64_t reduced;
+        uint64_t first_child;
+        uint32_t child_count;
+        int32_t delta, gamma;
+        int order, memo;
+        std::string terminal;  // "SUCCESS", "FAIL" or "NOT" for inner nodes
+        std::vector<int> first, second;
+    };
+
+    struct TransitionInfo {
+        std::string id, label;
+        std::vector<int> change;
+    };
+
+    /**
+     * Maps a file written by ProofTree::WriteBinary
+     * @throws std::runtime_error if the file cannot be read or is not a proof tree
+     */
+    explicit TreeFile(const std::string& path);
+
+    TreeFile(const TreeFile&) = delete;
+    TreeFile& operator=(const TreeFile&) = delete;
+
+    ~TreeFile();
+
+    [[nodiscard]] uint64_t NodeCount() const;
+
+    [[nodiscard]] size_t PlaceNum() const;
+
+    /**
+     * @return 0 if the resources are not bisimilar, 1 if they are, 2 if the check was stopped
+     */
+    [[nodiscard]] int Verdict() const;
+
+    /**
+     * Decodes a node
+     * @throws std::out_of_range if there is no such node
+     */
+    [[nodiscard]] Node GetNode(uint64_t id) const;
+
+    [[nodiscard]] const std::vector<TransitionInfo>& Transitions() const;
+
+    [[nodiscard]] std::vector<std::pair<std::vector<int>, std::vector<int>>> Basis() const;
+
+    [[nodiscard]] bool HasBasis() const;
+
+    /**
+     * Converts the tree to GraphML, numbering the nodes in the order of ProofTree::PrintTree
+     * @param path path to the file, compressed with gzip or zstd if it ends with .gz or .zst
+     */
+    void WriteGraphML(const std::string& path) const;
+
+private:
+    [[nodiscard]] const treefile::NodeRecord& Record(uint64_t id) const;
+
+    [[nodiscard]] std::vector<int> UnpackMarking(const char* packed) const;
+
+    void Map(const std::string& path);
+
+    void Unmap();
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    void* mapping_ = nullptr;  // platform handle of the mapping
+    treefile::Header header_{};
+    size_t node_stride_ = 0;
+    std::vector<TransitionInfo> transitions_;
+};
@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "petrinets/certificate.h"
+#include "petrinets/petrinet.h"
+#include "petrinets/pnml.h"
+#include "petrinets/prooftree.h"
+
+namespace {
+
+using certificate::kNone;
+using certificate::StepRecord;
+
+/**
+ * Certificate of a small proof on nets/coins.pnml, with REDUCE steps and a leaf closed by an
+ * earlier node, whose steps the tests tamper with
+ */
+class CertificateTest : public testing::Test {
+protected:
+    void SetUp() override {
+        pnml_ = ReadPnml(std::string(BISIMILARITY_NETS_DIR) + "/coins.pnml");
+        net_ = std::make_unique<PetriNet>(pnml_.transitions, pnml_.places.size());
+        first_ = Marking({{"10c", 1}, {"shop", 1}});
+        second_ = Marking({{"5c", 2}, {"shop", 1}});
+        ProofTree tree(Multiset(first_), Multiset(second_), net_.get(), false);
+        tree.SetCertifiable(true);
+        ASSERT_EQ(tree.CheckBisimilarity(), Verdict::kBisimilar);
+        path_ = testing::TempDir() + "certificate_test.pncert";
+        tree.WriteCertificate(path_);
+
+        std::ifstream file(path_, std::ios::binary);
+        bytes_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        certificate::Header header;
+        ASSERT_GE(bytes_.size(), sizeof(header));
+        std::copy_n(bytes_.data(), sizeof(header), reinterpret_cast<char*>(&header));
+        steps_offset_ = sizeof(header) + 2 * header.place_num * sizeof(int32_t);
+        steps_.resize(header.node_count);
+        ASSERT_GE(bytes_.size(), steps_offset_ + steps_.size() * sizeof(StepRecord));
+        std::copy_n(bytes_.data() + steps_offset_, steps_.size() * sizeof(StepRecord),
+                    reinterpret_cast<char*>(steps_.data()));
+
+        // Shape of the tree, the steps being in preorder
+        std::vector<uint64_t> open;
+        std::vector<uint64_t> remaining;
+        for (uint64_t id = 0; id < steps_.size(); ++id) {
+            while (!remaining.empty() && remaining.back() == 0) {
+                end_[open.back()] = id;
+                open.pop_back();
+                remaining.pop_back();
+            }
+            if (id > 0) {
+                --remaining.back();
+            }
+            parent_.push_back(open.empty() ? kNone : open.back());
+            level_.push_back(open.size());
+            end_.push_back(steps_.size());
+            open.push_back(id);
+            remaining.push_back(steps_[id].child_count);
+        }
+    }
+
+    std::vector<int> Marking(const std::vector<std::pair<std::string, int>>& tokens) const {
+        std::vector<int> marking(pnml_.places.size());
+        for (auto&& [place, count] : tokens) {
+            auto it = std::find(pnml_.places.begin(), pnml_.places.end(), place);
+            if (it == pnml_.places.end()) {
+                throw std::runtime_error("coins.pnml has no place " + place);
+            }
+            marking[it - pnml_.places.begin()] = count;
+        }
+        return marking;
+    }
+
+    /**
+     * Verifies the certificate with its steps changed
+     */
+    CertificateReport VerifyTampered(const std::function<void(std::vector<StepRecord>*)>& change) {
+        std::vector<StepRecord> steps = steps_;
+        change(&steps);
+        std::string bytes = bytes_;
+        std::copy_n(reinterpret_cast<const char*>(steps.data()), steps.size() * sizeof(StepRecord),
+                    bytes.begin() + steps_offset_);
+        std::string path = testing::TempDir() + "certificate_test_tampered.pncert";
+        std::ofstream(path, std::ios::binary) << bytes;
+        return VerifyCertificate(path, *net_);
+    }
+
+    PnmlNet pnml_;
+    std::unique_ptr<PetriNet> net_;
+    std::vector<int> first_, second_;
+    std::string path_;
+    std::string bytes_;
+    size_t steps_offset_ = 0;
+    std::vector<StepRecord> steps_;
+    std::vector<uint64_t> parent_;  // kNone for the root
+    std::vector<uint64_t> level_;
+    std::vector<uint64_t> end_;     // first step after the subtree of every node
+};
+
+TEST_F(CertificateTest, ProofHolds) {
+    CertificateReport report = VerifyCertificate(path_, *net_, 4);
+    EXPECT_TRUE(report.valid) << report.error;
+    EXPECT_EQ(report.first, first_);
+    EXPECT_EQ(report.second, second_);
+    EXPECT_EQ(report.node_count, steps_.size());
+}
+
+TEST_F(CertificateTest, WrongGammaFails) {
+    auto delta = std::find_if(steps_.begin() + 1, steps_.end(),
+                              [](const StepRecord& step) { return step.order != 0; });
+    ASSERT_NE(delta, steps_.end());
+    uint64_t id = delta - steps_.begin();
+    const auto& transitions = net_->GetTransitions();
+    for (size_t gamma = 0; gamma < transitions.size(); ++gamma) {
+        if (static_cast<int32_t>(gamma) == delta->gamma) {
+            continue;
+        }
+        CertificateReport report = VerifyTampered([&](std::vector<StepRecord>* steps) {
+            (*steps)[id].gamma = static_cast<int32_t>(gamma);
+        });
+        EXPECT_FALSE(report.valid) << "gamma " << gamma;
+    }
+}
+
+TEST_F(CertificateTest, ReduceToNonAncestorFails) {
+    auto reduce = std::find_if(steps_.begin(), steps_.end(),
+                               [](const StepRecord& step) { return step.reduced != kNone; });
+    ASSERT_NE(reduce, steps_.end());
+    uint64_t id = reduce - steps_.begin();
+    // The parent itself is not a proper ancestor of the parent
+    CertificateReport report = VerifyTampered(
+        [&](std::vector<StepRecord>* steps) { (*steps)[id].reduced = parent_[id]; });
+    EXPECT_FALSE(report.valid);
+    EXPECT_NE(report.error.find("not an ancestor of the parent"), std::string::npos)
+        << report.error;
+}
+
+TEST_F(CertificateTest, OpenWitnessFails) {
+    auto leaf = std::find_if(steps_.begin() + 1, steps_.end(),
+                             [](const StepRecord& step) { return step.child_count == 0; });
+    ASSERT_NE(leaf, steps_.end());
+    uint64_t id = leaf - steps_.begin();
+    CertificateReport report = VerifyTampered(
+        [&](std::vector<StepRecord>* steps) { (*steps)[id].witness = parent_[id]; });
+    EXPECT_FALSE(report.valid);
+    EXPECT_NE(report.error.find("closed by one of its ancestors"), std::string::npos)
+        << report.error;
+}
+
+TEST_F(CertificateTest, WitnessUnderOuterAssumptionFails) {
+    // The parent of a REDUCE child assumes the ancestor it was reduced by, so it closes no leaf
+    // outside of the subtree of that ancestor
+    for (uint64_t id = 0; id < steps_.size(); ++id) {
+        if (steps_[id].reduced == kNone || level_[steps_[id].reduced] == 0) {
+            continue;
+        }
+        uint64_t witness = parent_[id];
+        for (uint64_t leaf = end_[steps_[id].reduced]; leaf < steps_.size(); ++leaf) {
+            if (steps_[leaf].child_count != 0) {
+                continue;
+            }
+            CertificateReport report = VerifyTampered(
+                [&](std::vector<StepRecord>* steps) { (*steps)[leaf].witness = witness; });
+            EXPECT_FALSE(report.valid);
+            EXPECT_NE(report.error.find("not an ancestor of the leaf"), std::string::npos)
+                << report.error;
+            return;
+        }
+    }
+    FAIL() << "The proof has no leaf outside of the subtree of an assumed ancestor";
+}
+
+TEST_F(CertificateTest, TruncatedFileThrows) {
+    std::string path = testing::TempDir() + "certificate_test_truncated.pncert";
+    std::ofstream(path, std::ios::binary) << bytes_.substr(0, bytes_.size() - 1);
+    EXPECT_THROW(VerifyCertificate(path, *net_), std::runtime_error);
+}
+
+}  // namespace
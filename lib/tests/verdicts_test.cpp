@@ -0,0 +1,236 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "netgen.h"
+#include "petrinets/certificate.h"
+#include "petrinets/petrinet.h"
+#include "petrinets/pnml.h"
+#include "petrinets/prooftree.h"
+
+namespace {
+
+/**
+ * Pair of resources on a bundled net or a generated one, with its known verdict
+ */
+struct VerdictCase {
+    std::string name;
+    GeneratedNet net;
+};
+
+/**
+ * Options of the search that must not change any verdict
+ */
+struct SearchConfig {
+    std::string name;
+    bool memoize = true;
+    size_t thread_num = 1;
+    SearchStrategy strategy;
+    bool spill = false;
+};
+
+/**
+ * Pair on a net of nets/, with the resources given by place id
+ */
+VerdictCase BundledCase(const std::string& name, const std::string& file,
+                        const std::vector<std::pair<std::string, int>>& first,
+                        const std::vector<std::pair<std::string, int>>& second, bool bisimilar) {
+    VerdictCase result{name, {}};
+    result.net.net = ReadPnml(std::string(BISIMILARITY_NETS_DIR) + "/" + file);
+    auto marking = [&](const std::vector<std::pair<std::string, int>>& tokens) {
+        const auto& places = result.net.net.places;
+        std::vector<int> row(places.size());
+        for (auto&& [place, count] : tokens) {
+            auto it = std::find(places.begin(), places.end(), place);
+            if (it == places.end()) {
+                throw std::runtime_error(file + " has no place " + place);
+            }
+            row[it - places.begin()] = count;
+        }
+        return row;
+    };
+    result.net.first = marking(first);
+    result.net.second = marking(second);
+    result.net.bisimilar = bisimilar;
+    return result;
+}
+
+std::vector<VerdictCase> Cases() {
+    std::vector<VerdictCase> cases{
+        BundledCase("coins_10c_5c", "coins.pnml", {{"10c", 1}, {"shop", 1}},
+                    {{"5c", 2}, {"shop", 1}}, true),
+        BundledCase("coins_short", "coins.pnml", {{"10c", 1}, {"shop", 1}},
+                    {{"5c", 1}, {"shop", 1}}, false),
+        BundledCase("coins_mixed", "coins.pnml", {{"10c", 1}, {"5c", 1}, {"shop", 1}},
+                    {{"5c", 3}, {"shop", 1}}, true),
+        BundledCase("coins_two_shops", "coins.pnml", {{"10c", 4}, {"5c", 2}, {"shop", 2}},
+                    {{"10c", 2}, {"5c", 6}, {"shop", 2}}, true),
+        BundledCase("coins_three_shops", "coins.pnml", {{"10c", 6}, {"shop", 3}},
+                    {{"5c", 12}, {"shop", 3}}, true),
+        BundledCase("cyclic", "cyclic.pnml", {{"p1", 2}}, {{"p1", 1}, {"p2", 1}}, true),
+        BundledCase("cyclic_large", "cyclic.pnml", {{"p1", 7}, {"p2", 3}},
+                    {{"p1", 4}, {"p2", 6}}, true),
+        BundledCase("test", "test.pnml", {{"p1", 1}}, {{"p2", 1}}, true),
+        BundledCase("exclusive", "exclusive.pnml", {{"x2", 1}}, {{"y2", 1}}, false),
+        BundledCase("exclusive_two", "exclusive.pnml", {{"x3", 1}, {"x4", 1}},
+                    {{"y3", 1}, {"y4", 1}}, false),
+        BundledCase("exclusive_empty", "exclusive.pnml", {{"x1", 1}}, {}, false),
+        BundledCase("big_cycle_empty", "big_cycle.pnml", {{"p1", 1}}, {}, false),
+    };
+    // Sizes that every configuration decides well within the budget, most of them cost
+    // a hundred times more nodes without the transposition table
+    for (size_t branches : {2, 3}) {
+        for (size_t depth : {1, 2}) {
+            for (bool bisimilar : {true, false}) {
+                cases.push_back({"choice_" + std::to_string(branches) + "_" +
+                                     std::to_string(depth) + (bisimilar ? "" : "_refuted"),
+                                 ChoiceNet(branches, depth, bisimilar)});
+            }
+        }
+    }
+    for (int purchases : {1, 2}) {
+        cases.push_back({"coins_2_" + std::to_string(purchases), CoinNet(2, purchases)});
+    }
+    cases.push_back({"cycle_4_2", CycleNet(4, 2, 2)});
+    cases.push_back({"cycle_6_3", CycleNet(6, 3, 2)});
+    cases.push_back({"cycle_8_4", CycleNet(8, 4, 1)});
+    return cases;
+}
+
+std::vector<VerdictCase> BisimilarCases() {
+    std::vector<VerdictCase> cases = Cases();
+    cases.erase(std::remove_if(cases.begin(), cases.end(),
+                               [](const VerdictCase& verdict_case) {
+                                   return !verdict_case.net.bisimilar;
+                               }),
+                cases.end());
+    return cases;
+}
+
+std::vector<SearchConfig> Configs() {
+    std::vector<SearchConfig> configs(6);
+    configs[0].name = "default";
+    configs[1].name = "no_memo";
+    configs[1].memoize = false;
+    configs[2].name = "threads";
+    configs[2].thread_num = 4;
+    configs[3].name = "deepening";
+    configs[3].strategy = {3, ChildOrder::kNet, GammaOrder::kNet};
+    configs[4].name = "farthest_closest";
+    configs[4].strategy = {0, ChildOrder::kFarthestFirst, GammaOrder::kClosestFirst};
+    configs[5].name = "spill";
+    configs[5].spill = true;
+    return configs;
+}
+
+void PrintTo(const VerdictCase& verdict_case, std::ostream* out) {
+    *out << verdict_case.name;
+}
+
+void PrintTo(const SearchConfig& config, std::ostream* out) {
+    *out << config.name;
+}
+
+/**
+ * Applies the options of the configuration to a tree of the case
+ */
+void Configure(ProofTree* tree, const VerdictCase& verdict_case, const SearchConfig& config) {
+    SearchLimits limits;
+    limits.max_nodes = 200000;
+    tree->SetLimits(limits);
+    tree->SetMemoization(config.memoize);
+    tree->SetStrategy(config.strategy);
+    if (config.spill) {
+        tree->SetSpilling(testing::TempDir() + "verdicts_" + verdict_case.name + ".spill");
+    }
+}
+
+class VerdictTest : public testing::TestWithParam<std::tuple<VerdictCase, SearchConfig>> {};
+
+TEST_P(VerdictTest, MatchesKnownVerdict) {
+    const auto& [verdict_case, config] = GetParam();
+    const GeneratedNet& generated = verdict_case.net;
+    PetriNet net(generated.net.transitions, generated.net.places.size());
+    ProofTree tree(Multiset(generated.first), Multiset(generated.second), &net, false,
+                   config.thread_num);
+    Configure(&tree, verdict_case, config);
+    Verdict expected = generated.bisimilar ? Verdict::kBisimilar : Verdict::kNotBisimilar;
+    EXPECT_EQ(tree.CheckBisimilarity(), expected);
+}
+
+/**
+ * Proofs searched without the transposition table, the same with any number of threads
+ */
+class ThreadedTreeTest : public testing::TestWithParam<VerdictCase> {};
+
+TEST_P(ThreadedTreeTest, MatchesSequentialWithoutMemo) {
+    const VerdictCase& verdict_case = GetParam();
+    const GeneratedNet& generated = verdict_case.net;
+    PetriNet net(generated.net.transitions, generated.net.places.size());
+    SearchConfig config;
+    config.memoize = false;
+    std::vector<TreeArrays> trees;
+    for (size_t thread_num : {1, 4}) {
+        ProofTree tree(Multiset(generated.first), Multiset(generated.second), &net, false,
+                       thread_num);
+        Configure(&tree, verdict_case, config);
+        ASSERT_EQ(tree.CheckBisimilarity(), Verdict::kBisimilar);
+        trees.push_back(tree.ToArrays());
+    }
+    const TreeArrays& sequential = trees[0];
+    const TreeArrays& threaded = trees[1];
+    ASSERT_EQ(threaded.node_count, sequential.node_count);
+    EXPECT_EQ(threaded.first, sequential.first);
+    EXPECT_EQ(threaded.second, sequential.second);
+    EXPECT_EQ(threaded.parent, sequential.parent);
+    EXPECT_EQ(threaded.delta, sequential.delta);
+    EXPECT_EQ(threaded.gamma, sequential.gamma);
+    EXPECT_EQ(threaded.order, sequential.order);
+    EXPECT_EQ(threaded.reduced, sequential.reduced);
+    EXPECT_EQ(threaded.terminal, sequential.terminal);
+}
+
+/**
+ * Certificates of the bisimilar cases, written and verified in every configuration
+ */
+class ProofCertificateTest : public VerdictTest {};
+
+TEST_P(ProofCertificateTest, Holds) {
+    const auto& [verdict_case, config] = GetParam();
+    const GeneratedNet& generated = verdict_case.net;
+    PetriNet net(generated.net.transitions, generated.net.places.size());
+    ProofTree tree(Multiset(generated.first), Multiset(generated.second), &net, false,
+                   config.thread_num);
+    tree.SetCertifiable(true);
+    Configure(&tree, verdict_case, config);
+    ASSERT_EQ(tree.CheckBisimilarity(), Verdict::kBisimilar);
+    std::string path = testing::TempDir() + "verdicts_" + verdict_case.name + ".pncert";
+    tree.WriteCertificate(path);
+    CertificateReport report = VerifyCertificate(path, net, 2);
+    EXPECT_TRUE(report.valid) << report.error;
+    EXPECT_EQ(report.first, generated.first);
+    EXPECT_EQ(report.second, generated.second);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Nets, VerdictTest, testing::Combine(testing::ValuesIn(Cases()), testing::ValuesIn(Configs())),
+    [](const testing::TestParamInfo<VerdictTest::ParamType>& info) {
+        return std::get<0>(info.param).name + "_" + std::get<1>(info.param).name;
+    });
+
+INSTANTIATE_TEST_SUITE_P(Nets, ThreadedTreeTest, testing::ValuesIn(BisimilarCases()),
+                         [](const testing::TestParamInfo<VerdictCase>& info) {
+                             return info.param.name;
+                         });
+
+INSTANTIATE_TEST_SUITE_P(
+    Nets, ProofCertificateTest,
+    testing::Combine(testing::ValuesIn(BisimilarCases()), testing::ValuesIn(Configs())),
+    [](const testing::TestParamInfo<ProofCertificateTest::ParamType>& info) {
+        return std::get<0>(info.param).name + "_" + std::get<1>(info.param).name;
+    });
+
+}  // namespace
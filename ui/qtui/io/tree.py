@@ -1,4 +1,5 @@
-from typing import Tuple
+import gzip
+from typing import Tuple, BinaryIO
 from xml.dom import minidom
 
 
@@ -12,19 +13,35 @@ class Node:
         self.terminal: str = "NOT"
         self.reduced: str = "ROOT"
         self.direct_order: bool = True
+        self.child_ids = range(0)  # ids of the children not loaded yet, for binary trees
 
     def to_list(self):
         return ["#" + self.id, '(' + ", ".join(self.first) + ')', '(' + ", ".join(self.second) + ')',
                 self.reduced]
 
 
+def open_tree_file(path: str) -> BinaryIO:
+    """
+    Opens a .graphml file, decompressing it if it ends with .gz or .zst
+    :param path: path to the file
+    :return: binary file object
+    """
+    if path.endswith('.gz'):
+        return gzip.open(path, 'rb')
+    if path.endswith('.zst'):
+        import zstandard
+        return zstandard.open(path, 'rb')
+    return open(path, 'rb')
+
+
 def read_tree(path: str) -> Node:
     """
     Reads the result tree from a .graphml file
     :param path: path to the file
     :return: root node of the tree
     """
-    doc = minidom.parse(path)
+    with open_tree_file(path) as file:
+        doc = minidom.parse(file)
     nodes: dict[str, Node] = {}
 
     # Parsing nodes
@@ -44,6 +61,8 @@ def read_tree(path: str) -> Node:
                 node.direct_order = False
         elif 'reduced' in el.attributes:
             node.reduced = "REDUCE(#" + el.attributes['reduced'].value + ')'
+        if 'memo' in el.attributes:
+            node.reduced += ", MEMO(" + el.attributes['memo'].value + ')'
         nodes[node_id] = node
 
     # Parsing edges
@@ -69,9 +88,87 @@ def read_basis(path: str) -> list[Tuple[list[str], list[str]]]:
     :return: list of pairs of basis elements
     """
     basis = []
-    doc = minidom.parse(path)
+    with open_tree_file(path) as file:
+        doc = minidom.parse(file)
     for el in doc.getElementsByTagName('pair'):
         first = el.attributes['first'].value[1:-1].split(', ')
         second = el.attributes['second'].value[1:-1].split(', ')
         basis.append((first, second))
     return basis
+
+
+def read_tree_node(tree_file, node_id: int) -> Node:
+    """
+    Decodes a single node of a binary .ptree file without its children
+    :param tree_file: opened bisimilarity_checker.TreeFile
+    :param node_id: id of the node
+    :return: node with the ids of its children in child_ids
+    """
+    el = tree_file.node(node_id)
+    node = Node()
+    node.id = str(el.id)
+    node.first = [str(x) for x in el.first]
+    node.second = [str(x) for x in el.second]
+    node.terminal = el.terminal
+    if el.order != 0:
+        transitions = tree_file.transitions
+        node.reduced = "EXPAND(" + transitions[el.delta][0] + ", " + transitions[el.gamma][0] + ")"
+        node.direct_order = el.order > 0
+    elif el.reduced is not None:
+        node.reduced = "REDUCE(#" + str(el.reduced) + ')'
+    if el.memo != 0:
+        node.reduced += ", MEMO(" + ("proven" if el.memo > 0 else "refuted") + ')'
+    node.child_ids = range(*el.children)
+    return node
+
+
+def read_tree_file_basis(tree_file) -> list[Tuple[list[str], list[str]]]:
+    """
+    Reads a basis from a binary .ptree file
+    :param tree_file: opened bisimilarity_checker.TreeFile
+    :return: list of pairs of basis elements
+    """
+    return [([str(x) for x in first], [str(x) for x in second]) for first, second in tree_file.basis()]
+
+
+def read_result(result) -> Tuple[Node, list[Tuple[list[str], list[str]]]]:
+    """
+    Builds the tree and the basis from an in-memory check result, without a file
+    :param result: bisimilarity_checker.CheckResult
+    :return: root node of the tree and list of pairs of basis elements
+    """
+    transitions = [el.split(', ')[0] for el in result.transitions]
+    first = memoryview(result.first).tolist()
+    second = memoryview(result.second).tolist()
+    parent = memoryview(result.parent).tolist()
+    delta = memoryview(result.delta).tolist()
+    gamma = memoryview(result.gamma).tolist()
+    order = memoryview(result.order).tolist()
+    reduced = memoryview(result.reduced).tolist()
+    memo = memoryview(result.memo).tolist()
+    terminal = memoryview(result.terminal).tolist()
+
+    nodes: list[Node] = []
+    for i in range(result.node_count):
+        node = Node()
+        node.id = str(i)
+        node.first = [str(x) for x in first[i]]
+        node.second = [str(x) for x in second[i]]
+        node.terminal = ["NOT", "SUCCESS", "FAIL"][terminal[i]]
+        if order[i] != 0:
+            node.reduced = "EXPAND(" + transitions[delta[i]] + ", " + transitions[gamma[i]] + ")"
+            node.direct_order = order[i] > 0
+        elif reduced[i] >= 0:
+            node.reduced = "REDUCE(#" + str(reduced[i]) + ')'
+        if memo[i] != 0:
+            node.reduced += ", MEMO(" + ("proven" if memo[i] > 0 else "refuted") + ')'
+        # Parents come before their children
+        if parent[i] >= 0:
+            node.parent = nodes[parent[i]]
+            node.parent.children.append(node)
+        nodes.append(node)
+
+    basis_first, basis_second = result.basis
+    basis = [([str(x) for x in f], [str(x) for x in s])
+             for f, s in zip(memoryview(basis_first).tolist(), memoryview(basis_second).tolist())]
+    return nodes[0], basis
@@ -2,6 +2,7 @@ import os
 import sys
 from typing import List
 
+import bisimilarity_checker
 from PyQt5 import QtGui
 from PyQt5.QtCore import Qt, QThread
 from PyQt5.QtGui import QFont
@@ -11,9 +12,9 @@ from qt_material import apply_stylesheet
 
 from qtui.infowindow import InfoWindow
 from qtui.io.petri import read_net, read_resources, write_resources
-from qtui.io.tree import read_tree, read_basis
+from qtui.io.tree import read_tree_file_basis, read_result
 from qtui.widgetutils import show_message, create_label, QVLine, QHLine, create_table, get_file, Checker, \
-    populate_tree_view
+    populate_tree_view, populate_lazy_tree_view
 
 
 class MainWindow(QWidget):
@@ -139,6 +140,10 @@ class MainWindow(QWidget):
         start_button.clicked.connect(self.run_algorithm)
         self.togglable_elements.append(start_button)
         start_layout.addWidget(start_button)
+        self.cancel_button = QPushButton("CANCEL")
+        self.cancel_button.clicked.connect(self.cancel_algorithm)
+        self.cancel_button.setEnabled(False)
+        start_layout.addWidget(self.cancel_button)
         left_layout.addWidget(check_hint_label)
         left_layout.addLayout(start_layout, 100)
         left_layout.addWidget(QHLine(), 3)
@@ -222,41 +227,77 @@ class MainWindow(QWidget):
         """
         Runs the algorithm itself after getting a path to save the tree to
         """
-        tree_path = get_file("GraphML file (*.graphml)", self.base_path, read=False)
+        tree_path = get_file("Proof tree (*.graphml *.graphml.gz *.ptree)", self.base_path, read=False)
         if not tree_path:
             return
-        if len(tree_path) < 9 or tree_path[-8:] != '.graphml':
+        if not tree_path.endswith(('.graphml', '.graphml.gz', '.graphml.zst', '.ptree')):
             tree_path += '.graphml'
         transitions = [(key, *val) for key, val in self.net['transitions'].items()]
         self.status_label.setText("Running...")
         self.status_label.setStyleSheet("QLabel { color : black; }")
-        self.setDisabled(True)
+        self.set_running(True)
 
-        # Initializing a thread
+        # Initializing a thread, starting from the tree of the last check if there is one
+        previous = getattr(getattr(self, 'checker', None), 'tree', None)
         self.checker = Checker(list(map(int, self.s_table())), list(map(int, self.r_table())),
-                               transitions, self.basis_box.isChecked(), tree_path)
+                               transitions, self.basis_box.isChecked(), tree_path, previous)
         self.check_thread = QThread()
         self.checker.moveToThread(self.check_thread)
+        self.checker.progress.connect(self.show_progress)
         self.checker.finished.connect(self.check_thread.quit)
         self.check_thread.started.connect(self.checker.run_algorithm)
         self.check_thread.finished.connect(self.show_tree)
         self.check_thread.start()
 
+    def set_running(self, running: bool):
+        """
+        Locks the window while a check is running, leaving only the cancel button available
+        :param running: whether a check is running
+        """
+        for el in self.togglable_elements:
+            el.setEnabled(not running)
+        self.cancel_button.setEnabled(running)
+
+    def cancel_algorithm(self):
+        """
+        Stops the running check
+        """
+        self.cancel_button.setEnabled(False)
+        self.checker.cancel()
+
+    def show_progress(self, nodes: int, depth: int, speed: float):
+        """
+        Shows the progress reported by the running check
+        """
+        self.status_label.setText(f"Running... {nodes} nodes, depth {depth}, {speed:.0f} nodes/s")
+
     def show_tree(self):
         """
         Handles the ending of the algorithm runtime and subsequent tree loading
         """
-        self.setDisabled(False)
-        if self.checker.result:
+        self.set_running(False)
+        if self.checker.token.cancelled:
+            self.status_label.setText("Check cancelled")
+            self.status_label.setStyleSheet("QLabel { color : orange; }")
+        elif self.checker.result is None:
+            self.status_label.setText("Search budget exceeded")
+            self.status_label.setStyleSheet("QLabel { color : orange; }")
+        elif self.checker.result:
             self.status_label.setText("Bisimilarity found")
             self.status_label.setStyleSheet("QLabel { color : green; }")
         else:
             self.status_label.setText("Bisimilarity not found")
             self.status_label.setStyleSheet("QLabel { color : red; }")
         basis = None
-        if self.checker.check_basis:
-            basis = read_basis(self.checker.path)
-        populate_tree_view(read_tree(self.checker.path), self.tree_viewer, basis)
+        if self.checker.path.endswith('.ptree'):
+            # Binary trees are loaded node by node as the user expands them
+            tree_file = bisimilarity_checker.TreeFile(self.checker.path)
+            if self.checker.check_basis:
+                basis = read_tree_file_basis(tree_file)
+            populate_lazy_tree_view(tree_file, self.tree_viewer, basis)
+            return
+        root, basis = read_result(self.checker.tree)
+        populate_tree_view(root, self.tree_viewer, basis)
 
     def switch_theme(self):
         """
@@ -7,7 +7,7 @@ from PyQt5.QtGui import QFont, QIntValidator, QBrush, QColor
 from PyQt5.QtWidgets import QMessageBox, QLabel, QFrame, QTableWidget, QItemDelegate, QWidget, QStyleOptionViewItem, \
     QLineEdit, QFileDialog, QTreeWidget, QTreeWidgetItem
 
-from qtui.io.tree import Node
+from qtui.io.tree import Node, read_tree_node
 
 
 def show_message(icon: QMessageBox.Icon, title: str, text: str) -> None:
@@ -79,23 +79,71 @@ class Checker(QObject):
     Helper for async bisimilarity checking
     """
     finished = pyqtSignal()
+    progress = pyqtSignal(int, int, float)
 
-    def __init__(self, r, s, trans, basis, path):
+    def __init__(self, r, s, trans, basis, path, previous=None):
         super().__init__()
         self.r_res = r
         self.s_res = s
         self.transitions = trans
         self.check_basis = basis
         self.path = path
+        self.token = bisimilarity_checker.CancellationToken()
+        # The last check, whose choices are tried first after a small edit of the net or resources
+        self.previous = previous
 
     @pyqtSlot()
     def run_algorithm(self):
-        self.result = bisimilarity_checker.check_bisimilarity(self.r_res, self.s_res, self.transitions,
-                                                              self.check_basis,
-                                                              self.path)
+        # The tree stays in memory for the viewer, the file is only a copy for the user
+        self.tree = bisimilarity_checker.check(self.r_res, self.s_res, self.transitions, self.check_basis,
+                                               cancel=self.token, progress=self.progress.emit,
+                                               previous=self.previous)
+        self.previous = None
+        self.tree.write(self.path)
+        self.result = self.tree.verdict
         # noinspection PyUnresolvedReferences
         self.finished.emit()
 
+    def cancel(self):
+        """
+        Stops the running check, which then finishes with an unknown result
+        """
+        self.token.cancel()
+
+
+def create_tree_item(node: Node) -> QTreeWidgetItem:
+    """
+    Creates a tree view row for a node, colored by its terminal state
+    :param node: node to show
+    :return: created row
+    """
+    item = QTreeWidgetItem(node.to_list())
+    for i in range(2):
+        item.setTextAlignment(i + 1, Qt.AlignCenter)
+    if node.terminal == "SUCCESS":
+        item.setBackground(0, QBrush(QColor(Qt.green)))
+    elif node.terminal == "FAIL":
+        item.setBackground(0, QBrush(QColor(Qt.red)))
+    return item
+
+
+def add_basis_items(tree: QTreeWidget, basis) -> None:
+    """
+    Adds a basis to a tree view as a separate top level item
+    :param tree: tree view to add to
+    :param basis: list of pairs of basis elements
+    """
+    basis_root = QTreeWidgetItem(["Basis"])
+    for i in range(2):
+        basis_root.setTextAlignment(i + 1, Qt.AlignCenter)
+    for num, (first, second) in enumerate(basis):
+        child = QTreeWidgetItem(
+            ['#' + str(num), '(' + ", ".join(first) + ')', '(' + ", ".join(second) + ')', 'BASIS'])
+        for i in range(2):
+            child.setTextAlignment(i + 1, Qt.AlignCenter)
+        basis_root.addChild(child)
+    tree.addTopLevelItem(basis_root)
+
 
 def populate_tree_view(root: Node, tree: QTreeWidget, basis=None) -> None:
     """
@@ -104,44 +152,71 @@ def populate_tree_view(root: Node, tree: QTreeWidget, basis=None) -> None:
     :param tree: tree view to populate
     :param basis: basis of the
     """
-    root_item = QTreeWidgetItem(root.to_list())
-    for i in range(2):
-        root_item.setTextAlignment(i + 1, Qt.AlignCenter)
+    root_item = create_tree_item(root)
     stack: list[Tuple[Node, QTreeWidgetItem]] = [(root, root_item)]
 
-    # Initializing brushes
-    success = QBrush()
-    fail = QBrush()
-    success.setColor(QColor(Qt.green))
-    fail.setColor(QColor(Qt.red))
-
     while len(stack) > 0:
         cur, cur_item = stack.pop()
         for child in cur.children:
-            item = QTreeWidgetItem(child.to_list())
-            for i in range(2):
-                item.setTextAlignment(i + 1, Qt.AlignCenter)
+            item = create_tree_item(child)
             cur_item.addChild(item)
             stack.append((child, item))
-        if cur.terminal == "SUCCESS":
-            cur_item.setBackground(0, success)
-        elif cur.terminal == "FAIL":
-            cur_item.setBackground(0, fail)
 
     tree.clear()
+    tree.tree_file = None
     tree.addTopLevelItem(root_item)
 
     if basis:
-        basis_root = QTreeWidgetItem(["Basis"])
-        for i in range(2):
-            basis_root.setTextAlignment(i + 1, Qt.AlignCenter)
-        for num, (first, second) in enumerate(basis):
-            child = QTreeWidgetItem(
-                ['#' + str(num), '(' + ", ".join(first) + ')', '(' + ", ".join(second) + ')', 'BASIS'])
-            for i in range(2):
-                child.setTextAlignment(i + 1, Qt.AlignCenter)
-            basis_root.addChild(child)
-        tree.addTopLevelItem(basis_root)
+        add_basis_items(tree, basis)
+
+
+def populate_lazy_tree_view(tree_file, tree: QTreeWidget, basis=None) -> None:
+    """
+    Populates a given tree view from a binary .ptree file, decoding the children of a node only when
+    it is expanded, so that trees too large for memory can be browsed
+    :param tree_file: opened bisimilarity_checker.TreeFile
+    :param tree: tree view to populate
+    :param basis: basis of the
+    """
+    tree.clear()
+    tree.tree_file = tree_file
+    if not getattr(tree, 'lazy_expansion', False):
+        tree.itemExpanded.connect(lambda item: expand_lazy_item(tree, item))
+        tree.lazy_expansion = True
+    tree.addTopLevelItem(create_lazy_item(tree_file, 0))
+
+    if basis:
+        add_basis_items(tree, basis)
+
+
+def create_lazy_item(tree_file, node_id: int) -> QTreeWidgetItem:
+    """
+    Creates a row for a node of a binary tree, with a placeholder child standing for its unloaded children
+    :param tree_file: opened bisimilarity_checker.TreeFile
+    :param node_id: id of the node
+    :return: created row
+    """
+    node = read_tree_node(tree_file, node_id)
+    item = create_tree_item(node)
+    item.setData(0, Qt.UserRole, (node.child_ids.start, node.child_ids.stop))
+    if len(node.child_ids) > 0:
+        item.addChild(QTreeWidgetItem(["..."]))
+    return item
+
+
+def expand_lazy_item(tree: QTreeWidget, item: QTreeWidgetItem) -> None:
+    """
+    Replaces the placeholder child of an expanded row with the rows of the node's children
+    :param tree: tree view the row belongs to
+    :param item: expanded row
+    """
+    child_ids = item.data(0, Qt.UserRole)
+    if tree.tree_file is None or child_ids is None:
+        return
+    item.setData(0, Qt.UserRole, None)
+    item.takeChildren()
+    for child_id in range(*child_ids):
+        item.addChild(create_lazy_item(tree.tree_file, child_id))
 
 
 class NumberDelegate(QItemDelegate):